@@ -0,0 +1,655 @@
+/*
+benchmark.cc -- micro-benchmarks for performance critical code
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "compat.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <unistd.h>
+
+#include "Archive.h"
+#include "Detector.h"
+#include "HashPipeline.h"
+#include "Hashes.h"
+#include "HashesBatch.h"
+#include "hashes_accelerated.h"
+#include "MappedFile.h"
+#include "MemDBNative.h"
+#include "MemDBSqlite.h"
+#include "RomDB.h"
+#include "swap_accelerated.h"
+
+
+const char *usage = "usage: %s benchmark [size ...]\n"
+                    "\n"
+                    "benchmarks:\n"
+                    "  detector      swap data for detectors, sizes in bytes\n"
+                    "  file-hashes   hash files read and mapped, sizes in bytes\n"
+                    "  hashes        hash data, sizes in bytes\n"
+                    "  hashes-batch  hash small files one by one and in batches, sizes in bytes\n"
+                    "  memdb         fill and query in-memory file index, sizes are numbers of files\n"
+                    "  romdb-write   write ROM database, sizes are numbers of games\n";
+
+static int benchmark_detector(const std::vector<std::string> &arguments);
+static int benchmark_file_hashes(const std::vector<std::string> &arguments);
+static int benchmark_hashes(const std::vector<std::string> &arguments);
+static int benchmark_hashes_batch(const std::vector<std::string> &arguments);
+static int benchmark_memdb(const std::vector<std::string> &arguments);
+static int benchmark_romdb_write(const std::vector<std::string> &arguments);
+
+static const std::unordered_map<std::string, std::function<int(const std::vector<std::string> &)>> benchmarks = {
+    { "detector", benchmark_detector },
+    { "file-hashes", benchmark_file_hashes },
+    { "hashes", benchmark_hashes },
+    { "hashes-batch", benchmark_hashes_batch },
+    { "memdb", benchmark_memdb },
+    { "romdb-write", benchmark_romdb_write }
+};
+
+
+static std::vector<uint8_t> random_data(size_t size);
+static uint64_t parse_size(const std::string &size);
+static double time_it(const std::function<void()> &function);
+
+
+int
+main(int argc, char *argv[]) {
+    setprogname(argv[0]);
+
+    if (argc < 2) {
+        fprintf(stderr, usage, getprogname());
+        exit(1);
+    }
+
+    auto it = benchmarks.find(argv[1]);
+    if (it == benchmarks.end()) {
+        fprintf(stderr, "%s: unknown benchmark '%s'\n", getprogname(), argv[1]);
+        fprintf(stderr, "available benchmarks:");
+        for (const auto &benchmark : benchmarks) {
+            fprintf(stderr, " %s", benchmark.first.c_str());
+        }
+        fprintf(stderr, "\n");
+        exit(1);
+    }
+
+    std::vector<std::string> arguments(argv + 2, argv + argc);
+
+    try {
+        exit(it->second(arguments));
+    }
+    catch (std::exception &exception) {
+        fprintf(stderr, "%s: %s\n", getprogname(), exception.what());
+        exit(1);
+    }
+}
+
+
+// swap data for detector operations, alone and fused with hashing, with portable and accelerated swapping
+static int benchmark_detector(const std::vector<std::string> &arguments) {
+    std::vector<uint64_t> sizes;
+
+    for (const auto &argument : arguments) {
+        sizes.push_back(parse_size(argument));
+    }
+    if (sizes.empty()) {
+        sizes = { 1024 * 1024, 64 * 1024 * 1024 };
+    }
+
+    const std::vector<std::pair<std::string, Detector::Operation>> operations = {
+        { "bitswap", Detector::OP_BITSWAP },
+        { "byteswap", Detector::OP_BYTESWAP },
+        { "wordswap", Detector::OP_WORDSWAP }
+    };
+    const std::unordered_map<Detector::Operation, void (*)(uint8_t *, const uint8_t *, size_t)> swaps = {
+        { Detector::OP_BITSWAP, SwapAccelerated::bitswap },
+        { Detector::OP_BYTESWAP, SwapAccelerated::byteswap },
+        { Detector::OP_WORDSWAP, SwapAccelerated::wordswap }
+    };
+
+    SwapAccelerated::enabled = true;
+    printf("accelerated: %s\n", SwapAccelerated::description().c_str());
+    printf("%10s %-8s %-6s %12s %12s %8s\n", "size", "op", "what", "portable", "accelerated", "speedup");
+
+    for (auto size : sizes) {
+        if (size > Detector::MAX_DETECTOR_FILE_SIZE) {
+            fprintf(stderr, "%s: size %" PRIu64 " larger than maximum detector file size\n", getprogname(), size);
+            return 1;
+        }
+        auto data = random_data(size);
+        std::vector<uint8_t> swapped(size);
+        // process 64 MB in total per measurement to get stable timings
+        auto repeat = std::max(static_cast<uint64_t>(1), (64 * 1024 * 1024) / std::max(size, static_cast<uint64_t>(1)));
+
+        for (const auto &operation : operations) {
+            double swap_seconds[2], hash_seconds[2];
+            std::vector<uint8_t> swap_results[2];
+            Hashes hash_results[2];
+
+            auto detector = std::make_shared<Detector>();
+            detector->rules.emplace_back();
+            detector->rules.back().operation = operation.second;
+            const std::unordered_map<size_t, DetectorPtr> detectors = { { 0, detector } };
+
+            for (auto accelerated = 0; accelerated < 2; accelerated++) {
+                SwapAccelerated::enabled = accelerated != 0;
+
+                swap_seconds[accelerated] = time_it([&]() {
+                    for (uint64_t i = 0; i < repeat; i++) {
+                        swaps.at(operation.second)(swapped.data(), data.data(), size);
+                    }
+                });
+                swap_results[accelerated] = swapped;
+
+                hash_seconds[accelerated] = time_it([&]() {
+                    for (uint64_t i = 0; i < repeat; i++) {
+                        zip_error_t error;
+                        zip_error_init(&error);
+                        auto zip_source = zip_source_buffer_create(data.data(), size, 0, &error);
+                        zip_error_fini(&error);
+                        if (zip_source == nullptr) {
+                            throw std::runtime_error("can't create zip source");
+                        }
+                        auto source = ZipSource(zip_source);
+                        source.open();
+
+                        File file;
+                        file.hashes.size = size;
+                        Detector::compute_hashes(&source, &file, detectors);
+                        hash_results[accelerated] = file.detector_hashes[0];
+                    }
+                });
+            }
+
+            if (swap_results[0] != swap_results[1] || !(hash_results[0] == hash_results[1])) {
+                fprintf(stderr, "%s: %s results differ for size %" PRIu64 "\n", getprogname(), operation.first.c_str(), size);
+                return 1;
+            }
+
+            auto megabytes = static_cast<double>(size * repeat) / (1024 * 1024);
+            printf("%10" PRIu64 " %-8s %-6s %8.0f MB/s %8.0f MB/s %7.2fx\n", size, operation.first.c_str(), "swap", megabytes / swap_seconds[0], megabytes / swap_seconds[1], swap_seconds[0] / swap_seconds[1]);
+            printf("%10" PRIu64 " %-8s %-6s %8.0f MB/s %8.0f MB/s %7.2fx\n", size, operation.first.c_str(), "hashes", megabytes / hash_seconds[0], megabytes / hash_seconds[1], hash_seconds[0] / hash_seconds[1]);
+        }
+    }
+
+    SwapAccelerated::enabled = true;
+
+    return 0;
+}
+
+
+// hash files on disk by reading them into a buffer and by mapping them into memory
+static int benchmark_file_hashes(const std::vector<std::string> &arguments) {
+    std::vector<uint64_t> sizes;
+
+    for (const auto &argument : arguments) {
+        sizes.push_back(parse_size(argument));
+    }
+    if (sizes.empty()) {
+        sizes = { 4 * 1024, 1024 * 1024, 1024 * 1024 * 1024 };
+    }
+
+    auto file_name = (std::filesystem::temp_directory_path() / ("ckmame-benchmark-" + std::to_string(getpid()))).string();
+    auto chunk = random_data(1024 * 1024);
+
+    printf("%10s %12s %12s %8s\n", "size", "read", "mmap", "speedup");
+
+    for (auto size : sizes) {
+        auto fp = fopen(file_name.c_str(), "wb");
+        if (fp == nullptr) {
+            throw std::runtime_error("can't create '" + file_name + "': " + strerror(errno));
+        }
+        for (uint64_t written = 0; written < size;) {
+            auto n = std::min(size - written, static_cast<uint64_t>(chunk.size()));
+            if (fwrite(chunk.data(), 1, n, fp) != n) {
+                fclose(fp);
+                std::filesystem::remove(file_name);
+                throw std::runtime_error("can't write '" + file_name + "': " + strerror(errno));
+            }
+            written += n;
+        }
+        fclose(fp);
+
+        // hash at least 256 MB per measurement to get stable timings
+        auto repeat = std::max(static_cast<uint64_t>(1), (256 * 1024 * 1024) / std::max(size, static_cast<uint64_t>(1)));
+        double seconds[2];
+        Hashes results[2];
+
+        seconds[0] = time_it([&]() {
+            std::vector<uint8_t> buffer(64 * 1024);
+            for (uint64_t i = 0; i < repeat; i++) {
+                Hashes hashes;
+                hashes.add_types(Hashes::TYPE_ALL);
+                auto fp = fopen(file_name.c_str(), "rb");
+                if (fp == nullptr) {
+                    throw std::runtime_error("can't open '" + file_name + "': " + strerror(errno));
+                }
+                if (HashPipeline::is_worthwhile(&hashes, size)) {
+                    HashPipeline pipeline(&hashes);
+                    size_t n;
+                    while ((n = fread(pipeline.get_buffer(), 1, pipeline.buffer_size(), fp)) > 0) {
+                        pipeline.commit(n);
+                    }
+                    pipeline.end();
+                }
+                else {
+                    Hashes::Update hu(&hashes);
+                    size_t n;
+                    while ((n = fread(buffer.data(), 1, buffer.size(), fp)) > 0) {
+                        hu.update(buffer.data(), n);
+                    }
+                    hu.end();
+                }
+                fclose(fp);
+                results[0] = hashes;
+            }
+        });
+
+        seconds[1] = time_it([&]() {
+            for (uint64_t i = 0; i < repeat; i++) {
+                Hashes hashes;
+                hashes.add_types(Hashes::TYPE_ALL);
+                auto mapped = MappedFile::open(file_name);
+                if (!mapped) {
+                    throw std::runtime_error("can't map '" + file_name + "'");
+                }
+                if (HashPipeline::is_worthwhile(&hashes, size)) {
+                    HashPipeline::compute(&hashes, mapped->data(), mapped->size());
+                }
+                else {
+                    Hashes::Update hu(&hashes);
+                    hu.update(mapped->data(), mapped->size());
+                    hu.end();
+                }
+                results[1] = hashes;
+            }
+        });
+
+        if (!(results[0] == results[1])) {
+            std::filesystem::remove(file_name);
+            fprintf(stderr, "%s: hashes differ for size %" PRIu64 "\n", getprogname(), size);
+            return 1;
+        }
+
+        auto megabytes = static_cast<double>(size * repeat) / (1024 * 1024);
+        printf("%10" PRIu64 " %7.0f MB/s %7.0f MB/s %7.2fx\n", size, megabytes / seconds[0], megabytes / seconds[1], seconds[0] / seconds[1]);
+    }
+
+    std::filesystem::remove(file_name);
+
+    return 0;
+}
+
+
+static int benchmark_hashes(const std::vector<std::string> &arguments) {
+    std::vector<uint64_t> sizes;
+
+    for (const auto &argument : arguments) {
+        sizes.push_back(parse_size(argument));
+    }
+    if (sizes.empty()) {
+        sizes = { 1024 * 1024, 64 * 1024 * 1024 };
+    }
+
+    const std::vector<std::pair<std::string, int>> types = {
+        { "crc", Hashes::TYPE_CRC },
+        { "md5", Hashes::TYPE_MD5 },
+        { "sha1", Hashes::TYPE_SHA1 },
+        { "all", Hashes::TYPE_ALL }
+    };
+
+    HashesAccelerated::enabled = true;
+    printf("accelerated: %s\n", HashesAccelerated::description().c_str());
+    printf("%10s %-5s %12s %12s %8s\n", "size", "type", "portable", "accelerated", "speedup");
+
+    for (auto size : sizes) {
+        auto data = random_data(size);
+        // hash 64 MB in total per measurement to get stable timings
+        auto repeat = std::max(static_cast<uint64_t>(1), (64 * 1024 * 1024) / std::max(size, static_cast<uint64_t>(1)));
+
+        for (const auto &type : types) {
+            double seconds[2];
+            Hashes results[2];
+
+            for (auto accelerated = 0; accelerated < 2; accelerated++) {
+                HashesAccelerated::enabled = accelerated != 0;
+                seconds[accelerated] = time_it([&]() {
+                    for (uint64_t i = 0; i < repeat; i++) {
+                        Hashes hashes;
+                        hashes.add_types(type.second);
+                        Hashes::Update hu(&hashes);
+                        hu.update(data.data(), data.size());
+                        hu.end();
+                        results[accelerated] = hashes;
+                    }
+                });
+            }
+
+            if (!(results[0] == results[1])) {
+                fprintf(stderr, "%s: %s hashes differ for size %" PRIu64 "\n", getprogname(), type.first.c_str(), size);
+                return 1;
+            }
+
+            auto megabytes = static_cast<double>(size * repeat) / (1024 * 1024);
+            printf("%10" PRIu64 " %-5s %8.0f MB/s %8.0f MB/s %7.2fx\n", size, type.first.c_str(), megabytes / seconds[0], megabytes / seconds[1], seconds[0] / seconds[1]);
+        }
+    }
+
+    HashesAccelerated::enabled = true;
+
+    return 0;
+}
+
+
+// hash many small files one by one and in batches
+static int benchmark_hashes_batch(const std::vector<std::string> &arguments) {
+    std::vector<uint64_t> sizes;
+
+    for (const auto &argument : arguments) {
+        sizes.push_back(parse_size(argument));
+    }
+    if (sizes.empty()) {
+        sizes = { 4 * 1024, 64 * 1024, 512 * 1024 };
+    }
+
+    printf("accelerated: %s\n", HashesAccelerated::description().c_str());
+    printf("%10s %6s %12s %12s %8s\n", "size", "files", "single", "batched", "speedup");
+
+    for (auto size : sizes) {
+        auto count = std::max(static_cast<uint64_t>(16), (64 * 1024 * 1024) / std::max(size, static_cast<uint64_t>(1)));
+        std::vector<std::vector<uint8_t>> files;
+        for (uint64_t i = 0; i < count; i++) {
+            files.push_back(random_data(size + i % 64));
+        }
+
+        std::vector<Hashes> single(count);
+        std::vector<Hashes> batched(count);
+
+        auto seconds_single = time_it([&]() {
+            for (uint64_t i = 0; i < count; i++) {
+                single[i].add_types(Hashes::TYPE_ALL);
+                Hashes::Update hu(&single[i]);
+                hu.update(files[i].data(), files[i].size());
+                hu.end();
+            }
+        });
+
+        auto seconds_batched = time_it([&]() {
+            HashesBatch batch;
+            for (uint64_t i = 0; i < count; i++) {
+                batched[i].add_types(Hashes::TYPE_ALL);
+                batch.add(&batched[i], files[i]);
+                if (batch.full()) {
+                    batch.compute();
+                }
+            }
+            batch.compute();
+        });
+
+        for (uint64_t i = 0; i < count; i++) {
+            if (!(single[i] == batched[i])) {
+                fprintf(stderr, "%s: hashes differ for file %" PRIu64 " of size %" PRIu64 "\n", getprogname(), i, size);
+                return 1;
+            }
+        }
+
+        auto megabytes = static_cast<double>(size * count) / (1024 * 1024);
+        printf("%10" PRIu64 " %6" PRIu64 " %8.0f MB/s %8.0f MB/s %7.2fx\n", size, count, megabytes / seconds_single, megabytes / seconds_batched, seconds_single / seconds_batched);
+    }
+
+    return 0;
+}
+
+
+// insert files into and look up files in the in-memory file index, for both engines
+static int benchmark_memdb(const std::vector<std::string> &arguments) {
+    std::vector<uint64_t> counts;
+
+    for (const auto &argument : arguments) {
+        counts.push_back(parse_size(argument));
+    }
+    if (counts.empty()) {
+        counts = { 100000, 1000000 };
+    }
+
+    const size_t files_per_archive = 100;
+    const size_t lookups = 100000;
+
+    printf("%10s %-7s %14s %14s\n", "files", "engine", "insert", "find");
+
+    for (auto count : counts) {
+        std::mt19937_64 generator(count);
+        std::vector<ArchiveContentsPtr> archives;
+
+        for (uint64_t i = 0; i < count; i += files_per_archive) {
+            auto archive = std::make_shared<ArchiveContents>(ARCHIVE_ZIP, "extra/" + std::to_string(i), TYPE_ROM, FILE_EXTRA, 0);
+            archive->id = archives.size() + 1;
+            for (uint64_t j = i; j < std::min(count, i + files_per_archive); j++) {
+                File file;
+                file.name = std::to_string(j);
+                file.hashes.size = generator() % (4 * 1024 * 1024);
+                file.hashes.set_crc(static_cast<uint32_t>(generator()));
+                std::vector<uint8_t> sha1(Hashes::SIZE_SHA1);
+                for (auto &byte : sha1) {
+                    byte = static_cast<uint8_t>(generator());
+                }
+                file.hashes.set_sha1(sha1);
+                archive->files.push_back(file);
+            }
+            archives.push_back(archive);
+        }
+
+        // half of the lookups are for files that exist
+        std::vector<FileData> queries(lookups);
+        for (size_t i = 0; i < lookups; i++) {
+            if (i % 2 == 0) {
+                const auto &archive = archives[generator() % archives.size()];
+                queries[i].hashes = archive->files[generator() % archive->files.size()].hashes;
+            }
+            else {
+                queries[i].hashes.size = generator() % (4 * 1024 * 1024);
+                queries[i].hashes.set_crc(static_cast<uint32_t>(generator()));
+            }
+        }
+
+        const std::vector<std::pair<std::string, std::function<std::unique_ptr<MemDB>()>>> engines = {
+            { "sqlite", []() { return std::make_unique<MemDBSqlite>(":memory:"); } },
+            { "native", []() { return std::make_unique<MemDBNative>(); } }
+        };
+        std::vector<size_t> found(engines.size());
+
+        for (size_t engine = 0; engine < engines.size(); engine++) {
+            auto memdb = engines[engine].second();
+
+            auto seconds_insert = time_it([&]() {
+                for (const auto &archive : archives) {
+                    memdb->insert_archive(archive.get());
+                }
+            });
+
+            auto seconds_find = time_it([&]() {
+                for (const auto &query : queries) {
+                    found[engine] += memdb->find(TYPE_ROM, &query).size();
+                }
+            });
+
+            printf("%10" PRIu64 " %-7s %10.3f us %10.3f us\n", count, engines[engine].first.c_str(), seconds_insert * 1e6 / static_cast<double>(count), seconds_find * 1e6 / lookups);
+        }
+
+        if (found[0] != found[1]) {
+            fprintf(stderr, "%s: engines found different numbers of files: %zu, %zu\n", getprogname(), found[0], found[1]);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+// write games to a new ROM database, with all indexes in place vs. bulk loading and creating the indexes at the end
+static int benchmark_romdb_write(const std::vector<std::string> &arguments) {
+    std::vector<uint64_t> counts;
+
+    for (const auto &argument : arguments) {
+        counts.push_back(parse_size(argument));
+    }
+    if (counts.empty()) {
+        counts = { 40000 }; // about the size of a full MAME set
+    }
+
+    const size_t games_per_transaction = 4096;
+    auto file_name = (std::filesystem::temp_directory_path() / ("benchmark-romdb-" + std::to_string(getpid()) + ".db")).string();
+
+    printf("%10s %-8s %10s %12s\n", "games", "method", "seconds", "games/s");
+
+    for (auto count : counts) {
+        std::mt19937_64 generator(count);
+        std::vector<GamePtr> games;
+
+        // like a MAME dat: every third game is a clone that shares half its ROMs with its parent
+        for (uint64_t i = 0; i < count; i++) {
+            auto game = std::make_shared<Game>();
+            game->name = "game" + std::to_string(i);
+            game->description = "Game " + std::to_string(i);
+            auto roms = 1 + generator() % 48;
+            const Game *parent = nullptr;
+            if (i % 3 != 0) {
+                parent = games[i - i % 3].get();
+                game->cloneof[0] = parent->name;
+            }
+            for (uint64_t j = 0; j < roms; j++) {
+                Rom rom;
+                if (parent != nullptr && j % 2 == 0 && j < parent->files[TYPE_ROM].size()) {
+                    rom = parent->files[TYPE_ROM][j];
+                    rom.merge = rom.name;
+                }
+                else {
+                    rom.name = game->name + "." + std::to_string(j);
+                    rom.hashes.size = generator() % (4 * 1024 * 1024);
+                    rom.hashes.set_crc(static_cast<uint32_t>(generator()));
+                    std::vector<uint8_t> sha1(Hashes::SIZE_SHA1);
+                    for (auto &byte : sha1) {
+                        byte = static_cast<uint8_t>(generator());
+                    }
+                    rom.hashes.set_sha1(sha1);
+                }
+                game->files[TYPE_ROM].push_back(rom);
+            }
+            games.push_back(game);
+        }
+
+        const std::vector<std::pair<std::string, std::function<void(RomDB *)>>> methods = {
+            { "indexed", [&](RomDB *rom_db) {
+                rom_db->init2();
+                for (const auto &game : games) {
+                    rom_db->write_game(game.get());
+                }
+            } },
+            { "bulk", [&](RomDB *rom_db) {
+                rom_db->enable_bulk_load();
+                for (size_t i = 0; i < games.size(); i += games_per_transaction) {
+                    rom_db->begin_transaction();
+                    for (size_t j = i; j < std::min(games.size(), i + games_per_transaction); j++) {
+                        rom_db->insert_game(games[j].get());
+                    }
+                    rom_db->commit_transaction();
+                }
+                rom_db->init2();
+            } }
+        };
+
+        for (const auto &method : methods) {
+            auto seconds = time_it([&]() {
+                RomDB rom_db(file_name, DBH_NEW);
+                method.second(&rom_db);
+            });
+            std::filesystem::remove(file_name);
+
+            printf("%10" PRIu64 " %-8s %10.3f %12.0f\n", count, method.first.c_str(), seconds, static_cast<double>(count) / seconds);
+        }
+    }
+
+    return 0;
+}
+
+
+static std::vector<uint8_t> random_data(size_t size) {
+    std::vector<uint8_t> data(size);
+    std::mt19937 generator(size);
+
+    for (auto &byte : data) {
+        byte = static_cast<uint8_t>(generator());
+    }
+
+    return data;
+}
+
+
+static uint64_t parse_size(const std::string &size) {
+    size_t end;
+    auto value = std::stoull(size, &end);
+
+    switch (size.c_str()[end]) {
+        case '\0':
+            return value;
+        case 'k':
+        case 'K':
+            return value * 1024;
+        case 'm':
+        case 'M':
+            return value * 1024 * 1024;
+        case 'g':
+        case 'G':
+            return value * 1024 * 1024 * 1024;
+        default:
+            throw std::invalid_argument("invalid size '" + size + "'");
+    }
+}
+
+
+static double time_it(const std::function<void()> &function) {
+    auto start = std::chrono::steady_clock::now();
+    function();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
@@ -44,7 +44,7 @@
 #include "CkmameDB.h"
 #include "DB.h"
 #include "Exception.h"
-#include "MemDB.h"
+#include "MemDBSqlite.h"
 #include "RomDB.h"
 #include "SharedFile.h"
 #include "util.h"
@@ -195,7 +195,7 @@ int main(int argc, char *argv[]) {
                     break;
 
                 case DBTYPE_MEMDB:
-                    db = std::make_unique<MemDB>(db_fname);
+                    db = std::make_unique<MemDBSqlite>(db_fname);
                     break;
 
                 case DBTYPE_ROMDB:
@@ -268,7 +268,7 @@ static int db_format(DBType type) {
             return CkmameDB::format.id;
 
         case DBTYPE_MEMDB:
-            return MemDB::format.id;
+            return MemDBSqlite::format.id;
 
         case DBTYPE_ROMDB:
             return RomDB::format.id;
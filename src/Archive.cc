@@ -36,6 +36,7 @@
 #include <algorithm>
 #include <cerrno>
 #include <cstring>
+#include <deque>
 #include <utility>
 
 #include "config.h"
@@ -50,7 +51,11 @@
 #include "Exception.h"
 #include "file_util.h"
 #include "globals.h"
+#include "HashesBatch.h"
+#include "HashPipeline.h"
+#include "MappedFile.h"
 #include "MemDB.h"
+#include "PrecomputedHashes.h"
 #include "RomDB.h"
 #include "CkmameCache.h"
 
@@ -197,31 +202,38 @@ bool Archive::file_ensure_hashes(uint64_t idx, size_t detector_id, int hashtypes
 	Hashes hashes;
 	hashes.add_types(Hashes::TYPE_ALL);
 
+	if (!precomputed_hashes || !is_unchanged(idx) || !precomputed_hashes->get(name, file, &hashes)) {
+	    auto status = get_hashes_mapped(idx, &hashes);
 
-        ZipSourcePtr f;
+	    if (!status.has_value()) {
+		ZipSourcePtr f;
 
-	try {
-            f = get_source(idx);
-	    f->open();
-	} catch (Exception &e) {
-	    output.error("%s: %s: can't open: %s", name.c_str(), file.name.c_str(), e.what());
-	    file.broken = true;
-	    return false;
-	}
+		try {
+		    f = get_source(idx);
+		    f->open();
+		} catch (Exception &e) {
+		    output.error("%s: %s: can't open: %s", name.c_str(), file.name.c_str(), e.what());
+		    file.broken = true;
+		    return false;
+		}
 
-	switch (get_hashes(f.get(), file.hashes.size, true, &hashes)) {
-	case OK:
-	    break;
+		status = get_hashes(f.get(), file.hashes.size, true, &hashes);
+	    }
 
-	case READ_ERROR:
-	    output.error("%s: %s: can't compute hashes: %s", name.c_str(), file.name.c_str(), strerror(errno));
-	    file.broken = true;
-	    return false;
+	    switch (status.value()) {
+	    case OK:
+		break;
 
-	case CRC_ERROR:
-	    output.error("%s: %s: CRC error: %08x != %08x", name.c_str(), file.name.c_str(), hashes.crc, file.hashes.crc);
-	    file.broken = true;
-	    return false;
+	    case READ_ERROR:
+		output.error("%s: %s: can't compute hashes: %s", name.c_str(), file.name.c_str(), strerror(errno));
+		file.broken = true;
+		return false;
+
+	    case CRC_ERROR:
+		output.error("%s: %s: CRC error: %08x != %08x", name.c_str(), file.name.c_str(), hashes.crc, file.hashes.crc);
+		file.broken = true;
+		return false;
+	    }
 	}
 
 	file.hashes.set_hashes(hashes);
@@ -237,43 +249,149 @@ bool Archive::file_ensure_hashes(uint64_t idx, size_t detector_id, int hashtypes
 }
 
 
-std::optional<size_t> Archive::file_find_offset(size_t index, size_t size, const Hashes *hashes) {
-    Hashes hashes_part;
-
-    hashes_part.add_types(hashes->get_types());
-
+bool Archive::file_read(uint64_t index, std::vector<uint8_t> *data) {
     auto &file = files[index];
 
+    if (file.broken || !file.hashes.has_size()) {
+        return false;
+    }
+
     try {
         auto source = get_source(index);
-
         source->open();
-        
-        auto found = false;
-        size_t offset = 0;
-        while (offset + size <= file.hashes.size) {
-            if (get_hashes(source.get(), size, offset + size == file.hashes.size, &hashes_part) != OK) {
+
+        data->resize(file.hashes.size);
+        if (source->read(data->data(), data->size()) != data->size()) {
+            return false;
+        }
+        // detect CRC errors
+        uint8_t byte;
+        source->read(&byte, 1);
+    }
+    catch (Exception &e) {
+        return false;
+    }
+
+    return true;
+}
+
+
+std::optional<size_t> Archive::file_find_offset(size_t index, size_t size, const Hashes *hashes) {
+    auto &file = files[index];
+    if (file.broken) {
+        return {};
+    }
+
+    const auto &windows = get_window_crcs(index, size);
+    if (!windows.complete) {
+        // Matching windows can't be trusted if the file can't be read completely or its CRC is wrong.
+        file.broken = true;
+        return {};
+    }
+
+    auto other_types = hashes->get_types() & ~Hashes::TYPE_CRC;
+
+    for (size_t i = 0; i < windows.crcs.size(); i++) {
+        if (hashes->has_type(Hashes::TYPE_CRC) && windows.crcs[i] != hashes->crc) {
+            continue;
+        }
+
+        size_t offset = i * size;
+        if (other_types == 0) {
+            return offset;
+        }
+
+        // Only candidates are read again to compute the expensive hashes.
+        Hashes hashes_part;
+        hashes_part.add_types(hashes->get_types());
+        try {
+            auto source = get_source(index, offset, size);
+            source->open();
+            if (get_hashes(source.get(), size, false, &hashes_part) != OK) {
                 file.broken = true;
                 return {};
             }
+        }
+        catch (Exception &e) {
+            file.broken = true;
+            return {};
+        }
+        if (hashes->compare(hashes_part) == Hashes::MATCH) {
+            return offset;
+        }
+    }
 
-            if (hashes->compare(hashes_part) == Hashes::MATCH) {
-                found = true;
-                break;
-            }
+    return {};
+}
+
+
+const Archive::WindowCrcs &Archive::get_window_crcs(uint64_t index, size_t size) {
+    auto &file = files[index];
+    auto &windows = window_crcs[std::make_pair(index, size)];
+
+    if (windows.complete && windows.file_size == file.hashes.size && windows.file_crc == file.hashes.crc) {
+        return windows;
+    }
+
+    windows = WindowCrcs();
+    windows.file_size = file.hashes.size;
+    windows.file_crc = file.hashes.crc;
+
+    auto count = file.hashes.size / size;
+    windows.crcs.reserve(count);
 
-            offset += size;
+    try {
+        auto source = get_source(index);
+        source->open();
+
+        // Read the file once, computing only the CRC of each window and of the whole file.
+        unsigned char buf[BUFSIZE];
+        Hashes window;
+        window.add_types(Hashes::TYPE_CRC);
+        auto update = std::make_unique<Hashes::Update>(&window);
+        Hashes whole;
+        whole.add_types(Hashes::TYPE_CRC);
+        Hashes::Update whole_update(&whole);
+        uint64_t window_left = size;
+        uint64_t length = count * size;
+
+        while (length > 0) {
+            auto n = std::min(length, static_cast<uint64_t>(sizeof(buf)));
+            if (source->read(buf, n) != n) {
+                throw Exception();
+            }
+            length -= n;
+            whole_update.update(buf, n);
+
+            uint64_t done = 0;
+            while (done < n) {
+                auto m = std::min(n - done, window_left);
+                update->update(buf + done, m);
+                done += m;
+                window_left -= m;
+                if (window_left == 0) {
+                    update->end();
+                    windows.crcs.push_back(window.crc);
+                    update = std::make_unique<Hashes::Update>(&window);
+                    window_left = size;
+                }
+            }
         }
 
-        if (found) {
-            return offset;
+        uint64_t n;
+        while ((n = source->read(buf, sizeof(buf))) > 0) {
+            whole_update.update(buf, n);
+        }
+        whole_update.end();
+        if (file.hashes.has_type(Hashes::TYPE_CRC) && whole.crc != file.hashes.crc) {
+            return windows;
         }
+        windows.complete = true;
     }
     catch (Exception &e) {
-        file.broken = true;
     }
 
-    return {};
+    return windows;
 }
 
 
@@ -468,19 +586,38 @@ Archive::GetHashesStatus Archive::get_hashes(ZipSource *source, uint64_t length,
     unsigned char buf[BUFSIZE];
 
     try {
-        auto hu = Hashes::Update(hashes);
+        if (HashPipeline::is_worthwhile(hashes, length)) {
+            // decompress next buffer while previous ones are being hashed
+            HashPipeline pipeline(hashes);
+
+            while (length > 0) {
+                uint64_t n = std::min(length, static_cast<uint64_t>(pipeline.buffer_size()));
+                auto buffer = pipeline.get_buffer();
+                if (source->read(buffer, n) != n) {
+                    throw Exception();
+                }
 
-        while (length > 0) {
-            uint64_t n = std::min(length, static_cast<uint64_t>(sizeof(buf)));
-            if (source->read(buf, n) != n) {
-                throw Exception();
+                pipeline.commit(n);
+                length -= n;
             }
 
-            hu.update(buf, n);
-            length -= n;
+            pipeline.end();
         }
+        else {
+            auto hu = Hashes::Update(hashes);
 
-        hu.end();
+            while (length > 0) {
+                uint64_t n = std::min(length, static_cast<uint64_t>(sizeof(buf)));
+                if (source->read(buf, n) != n) {
+                    throw Exception();
+                }
+
+                hu.update(buf, n);
+                length -= n;
+            }
+
+            hu.end();
+        }
     }
     catch (Exception &e) {
         return READ_ERROR;
@@ -499,7 +636,52 @@ Archive::GetHashesStatus Archive::get_hashes(ZipSource *source, uint64_t length,
 }
 
 
+std::optional<Archive::GetHashesStatus> Archive::get_hashes_mapped(uint64_t index, Hashes *hashes) {
+    const auto &file = files[index];
+
+    if (!have_direct_file_access() || !is_unchanged(index) || !MappedFile::is_worthwhile(file.hashes.size)) {
+        return {};
+    }
+
+    auto mapped = MappedFile::open(get_original_filename(index));
+    if (!mapped) {
+        return {};
+    }
+    if (mapped->size() < file.hashes.size) {
+        return READ_ERROR;
+    }
+
+    auto ok = true;
+    if (HashPipeline::is_worthwhile(hashes, file.hashes.size)) {
+        ok = HashPipeline::compute(hashes, mapped->data(), file.hashes.size);
+    }
+    else {
+        auto hu = Hashes::Update(hashes);
+        ok = MappedFile::guard([&hu, &mapped, &file]() { hu.update(mapped->data(), file.hashes.size); });
+        hu.end();
+    }
+
+    if (!ok) {
+        // file was truncated while reading it
+        errno = EIO;
+        return READ_ERROR;
+    }
+    return OK;
+}
+
+
 void Archive::merge_files(const std::vector<File> &files_cache) {
+    // small files are read first and hashed together
+    HashesBatch batch;
+    std::deque<std::pair<uint64_t, Hashes>> batched_hashes;
+    auto compute_batch = [this, &batch, &batched_hashes]() {
+        batch.compute();
+        for (const auto &pair : batched_hashes) {
+            files[pair.first].hashes.set_hashes(pair.second);
+        }
+        batched_hashes.clear();
+    };
+
     for (uint64_t i = 0; i < files.size(); i++) {
         auto &file = files[i];
         
@@ -519,6 +701,17 @@ void Archive::merge_files(const std::vector<File> &files_cache) {
         }
         
         if (want_crc() && !file.hashes.has_type(Hashes::TYPE_CRC)) {
+            std::vector<uint8_t> data;
+            if (!precomputed_hashes && file.hashes.size <= HashesBatch::MAX_FILE_SIZE && file_read(i, &data)) {
+                batched_hashes.emplace_back(i, Hashes());
+                batched_hashes.back().second.add_types(Hashes::TYPE_ALL);
+                batch.add(&batched_hashes.back().second, std::move(data));
+                if (batch.full()) {
+                    compute_batch();
+                }
+                cache_changed = true;
+                continue;
+            }
             if (!file_ensure_hashes(i, Hashes::TYPE_ALL)) {
                 file.broken = true;
                 if (it == files_cache.cend() || !(*it).broken) {
@@ -530,6 +723,10 @@ void Archive::merge_files(const std::vector<File> &files_cache) {
         }
     }
     
+    if (!batch.empty()) {
+        compute_batch();
+    }
+
     if (files.size() != files_cache.size()) {
         cache_changed = true;
     }
@@ -659,7 +856,11 @@ bool Archive::compute_detector_hashes(size_t index, const std::unordered_map<siz
         return false;
     }
     
-    auto data = std::vector<uint8_t>(file.get_size(0));
+    if (file.get_size(0) > Detector::MAX_DETECTOR_FILE_SIZE) {
+        return false;
+    }
+
+    bool ok;
 
     try {
         auto source = get_source(index);
@@ -667,7 +868,7 @@ bool Archive::compute_detector_hashes(size_t index, const std::unordered_map<siz
             throw Exception("can't open: %s", strerror(errno));
         }
         source->open();
-        source->read(data.data(), data.size());
+        ok = Detector::compute_hashes(source.get(), &file, detectors);
     }
     catch (std::exception &e) {
         output.error("%s: %s: can't compute hashes: %s", name.c_str(), file.name.c_str(), e.what());
@@ -676,7 +877,6 @@ bool Archive::compute_detector_hashes(size_t index, const std::unordered_map<siz
         return false;
     }
 
-    auto ok = Detector::compute_hashes(data, &file, detectors);
     if (ok) {
 	memdb->update_file(contents.get(), index);
     }
@@ -34,6 +34,7 @@
   IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <map>
 #include <memory>
 #include <optional>
 #include <string>
@@ -138,13 +139,16 @@ public:
             EXISTS
         };
         
-        Change(): status(EXISTS) { }
+        Change(): status(EXISTS), file_start(0) { }
         
         Status status;
         std::string original_name;
         std::string source_name;
         ZipSourcePtr source;
         std::string file;
+        // part of file to copy, whole file if file_length is not set
+        uint64_t file_start;
+        std::optional<uint64_t> file_length;
     };
     
     static ArchivePtr by_id(uint64_t id);
@@ -184,6 +188,7 @@ public:
     [[nodiscard]] bool is_empty() const;
     [[nodiscard]] bool is_file_deleted(uint64_t index) const { return changes[index].status == Change::DELETED; }
     [[nodiscard]] bool is_writable() const { return (contents->flags & ARCHIVE_FL_RDONLY) == 0; }
+    [[nodiscard]] bool is_unchanged(uint64_t index) const { return index >= changes.size() || (changes[index].status == Change::EXISTS && changes[index].original_name.empty()); }
     [[nodiscard]] bool is_indexed() const { return (contents->flags & ARCHIVE_FL_NOCACHE) == 0 && IS_EXTERNAL(where); }
     virtual bool check() { return true; } // This is done as part of the constructor, remove?
     virtual bool close_xxx() { return true; }
@@ -195,6 +200,8 @@ public:
     [[nodiscard]] virtual bool have_direct_file_access() const { return false; }
     ZipSourcePtr get_source(uint64_t index) { return get_source(index, 0, {}); }
     virtual ZipSourcePtr get_source(uint64_t index, uint64_t start, std::optional<uint64_t> length) = 0;
+    // Source of compressed data of whole file, to add to zip archive without recompressing; nullptr if not supported.
+    virtual ZipSourcePtr get_compressed_source(uint64_t index) { return nullptr; }
     virtual std::string get_full_filename(uint64_t index) { return ""; }
     virtual std::string get_original_filename(uint64_t index) { return ""; }
 
@@ -219,10 +226,26 @@ protected:
 
     void add_file(const std::string &filename, const Hashes *hashes, const std::unordered_map<size_t, Hashes> *detector_hashes);
     GetHashesStatus get_hashes(ZipSource *source, uint64_t length, bool eof, Hashes *hashes);
+    std::optional<GetHashesStatus> get_hashes_mapped(uint64_t index, Hashes *hashes);
+    bool file_read(uint64_t index, std::vector<uint8_t> *data);
     void merge_files(const std::vector<File> &files_cache);
     
 private:
+    // CRCs of consecutive windows of a file, for finding ROMs in longer files.
+    class WindowCrcs {
+    public:
+        WindowCrcs() : file_size(0), file_crc(0), complete(false) { }
+
+        uint64_t file_size;
+        uint32_t file_crc;
+        std::vector<uint32_t> crcs;
+        bool complete; // false if reading the file failed after the last window in crcs or its CRC is wrong
+    };
+
+    std::map<std::pair<uint64_t, size_t>, WindowCrcs> window_crcs;
+
     bool compute_detector_hashes(size_t index, const std::unordered_map<size_t, DetectorPtr> &detectors);
+    const WindowCrcs &get_window_crcs(uint64_t index, size_t size);
 };
 
 #endif //* HAD_ARCHIVE_H
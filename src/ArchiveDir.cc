@@ -79,7 +79,12 @@ bool ArchiveDir::commit_xxx() {
 
                 added_names[file.name] = make_added_name(added_directory, file.name);
 
-                if (!link_or_copy(change.file, added_names[file.name])) {
+                if (change.file_length.has_value()) {
+                    if (!copy_file_contents(change.file, added_names[file.name], change.file_start, change.file_length)) {
+                        throw Exception();
+                    }
+                }
+                else if (!link_or_copy(change.file, added_names[file.name])) {
                     throw Exception();
                 }
             }
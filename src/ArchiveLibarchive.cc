@@ -34,13 +34,18 @@
 #include "ArchiveLibarchive.h"
 
 #include <archive_entry.h>
+#include <algorithm>
 #include <cstring>
 #include <cerrno>
 
+#include <unistd.h>
+
 #include "Exception.h"
 #include "file_util.h"
 #include "globals.h"
 
+const uint64_t ArchiveLibarchive::MAX_CACHE_SIZE = 256 * 1024 * 1024;
+
 
 ArchiveLibarchive::~ArchiveLibarchive() {
     try {
@@ -81,6 +86,8 @@ bool ArchiveLibarchive::check() {
 }
 
 bool ArchiveLibarchive::close_xxx() {
+    clear_cache();
+
     if (la == nullptr) {
         return true;
     }
@@ -259,13 +266,112 @@ void ArchiveLibarchive::commit_cleanup() {
 }
 
 
+void ArchiveLibarchive::clear_cache() {
+    if (cache_file != nullptr) {
+        fclose(cache_file);
+        cache_file = nullptr;
+    }
+    cache_size = 0;
+    cached_entries.clear();
+}
+
+
+bool ArchiveLibarchive::reserve_cache(uint64_t index) {
+    if (can_seek_over_entries() || cached_entries.find(index) != cached_entries.end() || cache_size + files[index].hashes.size > MAX_CACHE_SIZE) {
+        return false;
+    }
+    if (cache_file == nullptr) {
+        cache_file = std::tmpfile();
+    }
+    return cache_file != nullptr;
+}
+
+
+bool ArchiveLibarchive::can_seek_over_entries() const {
+    if (archive_filter_code(la, 0) != ARCHIVE_FILTER_NONE) {
+        return false;
+    }
+    switch (archive_format(la) & ARCHIVE_FORMAT_BASE_MASK) {
+    case ARCHIVE_FORMAT_AR:
+    case ARCHIVE_FORMAT_CPIO:
+    case ARCHIVE_FORMAT_TAR:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+
+bool ArchiveLibarchive::cache_rest_of_entry(uint64_t offset, uint64_t *position) {
+    uint8_t buffer[BUFSIZ];
+    auto size = files[current_index].hashes.size;
+
+    while (true) {
+        auto n = archive_read_data(la, buffer, sizeof(buffer));
+        if (n < 0) {
+            return false;
+        }
+        if (n == 0) {
+            break;
+        }
+        if (*position + static_cast<uint64_t>(n) > size || pwrite(fileno(cache_file), buffer, static_cast<size_t>(n), static_cast<off_t>(offset + *position)) != n) {
+            return false;
+        }
+        *position += static_cast<uint64_t>(n);
+    }
+
+    if (*position != size) {
+        return false;
+    }
+    cached_entries.emplace(current_index, CachedEntry(offset, size));
+    cache_size += size;
+    return true;
+}
+
+
 bool ArchiveLibarchive::Source::open() {
+    position = 0;
+
+    // The entry may have been cached or the cache cleared since this source was created.
+    auto it = archive->cached_entries.find(index);
+    if (archive->cache_file != nullptr && it != archive->cached_entries.end()) {
+        cached = it->second;
+        return true;
+    }
+    cached = std::nullopt;
+
     if (archive->have_open_file) {
         output.archive_error("cannot open '%s': archive busy", archive->files[index].name.c_str());
         return false;
     }
     
-    return archive->seek_to_entry(index);
+    if (!archive->seek_to_entry(index)) {
+        return false;
+    }
+
+    if (!complete_file && !windowed) {
+        // Created to read a cached entry at the requested offset, so skip to it.
+        uint8_t buffer[BUFSIZ];
+        while (position < start) {
+            auto n = archive_read_data(archive->la, buffer, static_cast<size_t>(std::min(static_cast<uint64_t>(sizeof(buffer)), start - position)));
+            if (n <= 0) {
+                output.archive_error("cannot open '%s': %s", archive->files[index].name.c_str(), n < 0 ? archive_error_string(archive->la) : "unexpected end of entry");
+                return false;
+            }
+            position += static_cast<uint64_t>(n);
+        }
+        position = 0;
+        return true;
+    }
+
+    // Keep a copy of the whole entry, so reading it again doesn't require decompressing the archive from the start.
+    caching = archive->reserve_cache(index);
+    if (caching) {
+        cache_offset = archive->cache_size;
+    }
+
+    return true;
 }
 
 bool ArchiveLibarchive::seek_to_entry(uint64_t index) {
@@ -296,7 +402,12 @@ bool ArchiveLibarchive::seek_to_entry(uint64_t index) {
         if (current_index == index) {
             break;
         }
-        
+
+        // Entries are skipped when read out of order; keep them so going back to them doesn't require a rewind.
+        if (reserve_cache(current_index)) {
+            uint64_t position = 0;
+            cache_rest_of_entry(cache_size, &position);
+        }
         if (archive_read_data_skip(la) != ARCHIVE_OK) {
             output.set_error_archive(name);
             output.archive_error("cannot open '%s': %s", files[index].name.c_str(), archive_error_string(la));
@@ -357,19 +468,25 @@ ZipSourcePtr ArchiveLibarchive::get_source(uint64_t index, uint64_t start, std::
     return std::make_shared<ZipSource>(source->get_source());
 }
                                        
-ArchiveLibarchive::Source::Source(ArchiveLibarchive *archive_, uint64_t index_, uint64_t start_, uint64_t length_, uint64_t file_length) : archive(archive_), index(index_), start(start_), length(length_) {
+ArchiveLibarchive::Source::Source(ArchiveLibarchive *archive_, uint64_t index_, uint64_t start_, uint64_t length_, uint64_t file_length_) : archive(archive_), index(index_), complete_file(start_ == 0 && length_ == file_length_), windowed(false), start(start_), length(length_), file_length(file_length_), caching(false), cache_offset(0), position(0) {
     zip_error_init(&error);
-    complete_file = (start == 0 && length == file_length);
 }
 
 zip_source_t *ArchiveLibarchive::Source::get_source() {
     auto source = zip_source_function_create(callback_c, this, nullptr);
-    if (!complete_file) {
+    // Cached entries are read directly at the requested offset.
+    auto it = archive->cached_entries.find(index);
+    if (it != archive->cached_entries.end()) {
+        cached = it->second;
+    }
+    else if (!complete_file) {
+        // Reads the whole entry, so it can be cached; the window selects the requested part.
         auto window_source = zip_source_window_create(source, start, (zip_int64_t)length, nullptr);
         if (window_source == nullptr) {
             zip_source_free(source);
             return nullptr;
         }
+        windowed = true;
         return window_source;
     }
     
@@ -390,15 +507,49 @@ zip_int64_t ArchiveLibarchive::Source::callback(void *data, zip_uint64_t len, zi
             return 0;
             
         case ZIP_SOURCE_READ: {
+            if (cached) {
+                if (archive->cache_file == nullptr) {
+                    // Cache was cleared while reading.
+                    zip_error_set(&error, ZIP_ER_READ, 0);
+                    return -1;
+                }
+                // Behind a window, the whole entry is read.
+                auto offset = windowed ? 0 : start;
+                auto n = std::min(len, (windowed ? file_length : length) - position);
+                if (n > 0 && pread(fileno(archive->cache_file), data, n, static_cast<off_t>(cached->offset + offset + position)) != static_cast<ssize_t>(n)) {
+                    zip_error_set(&error, ZIP_ER_READ, errno);
+                    return -1;
+                }
+                position += n;
+                return static_cast<zip_int64_t>(n);
+            }
+
+            if (!complete_file && !windowed) {
+                len = std::min(len, length - position);
+            }
             auto ret = archive_read_data(archive->la, data, len);
             if (ret < 0) {
                 zip_error_set(&error, ZIP_ER_READ, errno);
                 return -1;
             }
+            if (caching && ret > 0) {
+                if (pwrite(fileno(archive->cache_file), data, static_cast<size_t>(ret), static_cast<off_t>(cache_offset + position)) != ret) {
+                    caching = false;
+                }
+            }
+            position += static_cast<uint64_t>(ret);
             return ret;
         }
             
         case ZIP_SOURCE_CLOSE:
+            if (cached) {
+                return 0;
+            }
+            if (caching) {
+                // Also keep the part of the entry that wasn't read.
+                archive->cache_rest_of_entry(cache_offset, &position);
+            }
+            caching = false;
             if (archive_read_data_skip(archive->la) != ARCHIVE_OK) {
                 zip_error_set(&error, ZIP_ER_READ, errno);
                 return -1;
@@ -37,15 +37,17 @@
 
 #include <archive.h>
 
+#include <cstdio>
 #include <optional>
+#include <unordered_map>
 #include <utility>
 
 #include "Archive.h"
 
 class ArchiveLibarchive : public Archive {
 public:
-    ArchiveLibarchive(const std::string &name, filetype_t filetype, where_t where, int flags) : Archive(ARCHIVE_LIBARCHIVE, name, filetype, where, flags), la(nullptr), current_index(0), header_read(false), have_open_file(false) {  }
-    explicit ArchiveLibarchive(ArchiveContentsPtr contents) : Archive(std::move(contents)), la(nullptr), current_index(0), header_read(false), have_open_file(false) { }
+    ArchiveLibarchive(const std::string &name, filetype_t filetype, where_t where, int flags) : Archive(ARCHIVE_LIBARCHIVE, name, filetype, where, flags), la(nullptr), current_index(0), header_read(false), have_open_file(false), cache_file(nullptr), cache_size(0) {  }
+    explicit ArchiveLibarchive(ArchiveContentsPtr contents) : Archive(std::move(contents)), la(nullptr), current_index(0), header_read(false), have_open_file(false), cache_file(nullptr), cache_size(0) { }
 
     ~ArchiveLibarchive() override;
 
@@ -60,12 +62,22 @@ protected:
     ZipSourcePtr get_source(uint64_t index, uint64_t start, std::optional<uint64_t> length) override;
 
 private:
+    // Entries are copied to a temporary file while they are read or skipped, up to this many bytes per archive.
+    static const uint64_t MAX_CACHE_SIZE;
+
+    class CachedEntry {
+    public:
+        CachedEntry(uint64_t offset_, uint64_t size_) : offset(offset_), size(size_) { }
+        uint64_t offset;
+        uint64_t size;
+    };
+
     bool seek_to_entry(uint64_t index);
     void write_file(struct archive *writer, const ZipSourcePtr& source);
     
     class Source {
     public:
-        Source(ArchiveLibarchive *archive_, uint64_t index_, uint64_t start_, uint64_t length_, uint64_t file_length);
+        Source(ArchiveLibarchive *archive_, uint64_t index_, uint64_t start_, uint64_t length_, uint64_t file_length_);
         
         static zip_int64_t callback_c(void *userdata, void *data, zip_uint64_t len, zip_source_cmd_t cmd);
         zip_int64_t callback(void *data, zip_uint64_t len, zip_source_cmd_t cmd);
@@ -77,8 +89,18 @@ private:
         ArchiveLibarchive *archive;
         uint64_t index;
         bool complete_file;
+        // Behind a window source, which selects the range from the whole entry.
+        bool windowed;
         uint64_t start;
         uint64_t length;
+        uint64_t file_length;
+
+        // Read from the entry cache instead of the archive.
+        std::optional<CachedEntry> cached;
+        // Copying the entry to the cache while reading it.
+        bool caching;
+        uint64_t cache_offset;
+        uint64_t position;
 
         zip_error_t error;
     };
@@ -89,7 +111,18 @@ private:
     bool have_open_file;
     
     std::vector<time_t> mtimes;
-    
+
+    FILE *cache_file;
+    uint64_t cache_size;
+    std::unordered_map<uint64_t, CachedEntry> cached_entries;
+
+    void clear_cache();
+    // Check that caching is worth it, the entry is not cached yet and fits in the cache.
+    bool reserve_cache(uint64_t index);
+    // Entries can be skipped by seeking, without decompressing them.
+    bool can_seek_over_entries() const;
+    // Copy the rest of the current entry to the cache at offset, after the first position bytes, and add it to the cached entries.
+    bool cache_rest_of_entry(uint64_t offset, uint64_t *position);
     bool ensure_la();
     
 };
@@ -0,0 +1,160 @@
+/*
+ArchivePrefetcher.cc -- read archive metadata ahead of time
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ArchivePrefetcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ArchivePrefetcher::Statistics ArchivePrefetcher::statistics;
+
+namespace {
+const size_t BUFFER_SIZE = 64 * 1024;
+// end of central directory record is at most this far from the end of the file
+const uint64_t MAXIMUM_TAIL_SIZE = 22 + 0xffff;
+
+uint32_t get_uint32(const unsigned char *data) {
+    return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 | static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24;
+}
+}
+
+
+ArchivePrefetcher::Batch ArchivePrefetcher::prefetch(const std::vector<std::string> &archive_names) {
+    Batch batch;
+
+    for (const auto &name : archive_names) {
+        batch.push_back(pool.submit([name]() { prefetch_archive(name); }));
+        statistics.archives += 1;
+    }
+
+    return batch;
+}
+
+
+void ArchivePrefetcher::wait(Batch *batch) {
+    auto start = std::chrono::steady_clock::now();
+    auto blocked = false;
+
+    for (auto &future : *batch) {
+        if (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            blocked = true;
+            future.wait();
+        }
+    }
+
+    statistics.waits += 1;
+    if (blocked) {
+        statistics.blocked += 1;
+        statistics.blocked_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+
+void ArchivePrefetcher::prefetch_archive(const std::string &name) {
+    std::error_code ec;
+    auto status = std::filesystem::status(name, ec);
+
+    if (ec) {
+        return;
+    }
+    if (std::filesystem::is_directory(status)) {
+        prefetch_directory(name);
+    }
+    else if (std::filesystem::is_regular_file(status)) {
+        prefetch_zip(name);
+    }
+}
+
+
+void ArchivePrefetcher::prefetch_directory(const std::string &name) {
+    std::error_code ec;
+
+    for (auto it = std::filesystem::recursive_directory_iterator(name, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        std::error_code ignored;
+        (void)it->status(ignored);
+    }
+}
+
+
+void ArchivePrefetcher::prefetch_zip(const std::string &name) {
+    auto fd = open(name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat st = {};
+    if (fstat(fd, &st) < 0 || st.st_size < 22) {
+        close(fd);
+        return;
+    }
+    auto size = static_cast<uint64_t>(st.st_size);
+
+    std::vector<unsigned char> tail(std::min(size, MAXIMUM_TAIL_SIZE));
+    auto tail_offset = size - tail.size();
+    if (pread(fd, tail.data(), tail.size(), static_cast<off_t>(tail_offset)) != static_cast<ssize_t>(tail.size())) {
+        close(fd);
+        return;
+    }
+
+    // find end of central directory record and read central directory it points to
+    for (auto i = tail.size() - 22 + 1; i > 0; i--) {
+        auto record = tail.data() + i - 1;
+        if (get_uint32(record) != 0x06054b50) {
+            continue;
+        }
+
+        uint64_t cd_size = get_uint32(record + 12);
+        uint64_t cd_offset = get_uint32(record + 16);
+        if (cd_offset == 0xffffffff || cd_offset + cd_size > tail_offset + i - 1) {
+            // Zip64 or not a valid record
+            break;
+        }
+
+        unsigned char buffer[BUFFER_SIZE];
+        for (auto offset = cd_offset; offset < std::min(cd_offset + cd_size, tail_offset);) {
+            auto n = pread(fd, buffer, static_cast<size_t>(std::min(static_cast<uint64_t>(sizeof(buffer)), tail_offset - offset)), static_cast<off_t>(offset));
+            if (n <= 0) {
+                break;
+            }
+            offset += static_cast<uint64_t>(n);
+        }
+        break;
+    }
+
+    close(fd);
+}
@@ -0,0 +1,75 @@
+#ifndef HAD_ARCHIVE_PREFETCHER_H
+#define HAD_ARCHIVE_PREFETCHER_H
+
+/*
+ArchivePrefetcher.h -- read archive metadata ahead of time
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// Reads archive metadata (directory listings, zip central directories) in worker threads ahead of time, so it is in the operating system's caches when the main thread opens the archives.
+// Archives are still opened and parsed only in the main thread.
+class ArchivePrefetcher {
+public:
+    typedef std::vector<std::future<void>> Batch;
+
+    class Statistics {
+    public:
+        Statistics() : archives(0), waits(0), blocked(0), blocked_seconds(0) { }
+
+        uint64_t archives;
+        uint64_t waits;
+        uint64_t blocked; // number of waits for which prefetching wasn't done yet
+        double blocked_seconds;
+    };
+
+    explicit ArchivePrefetcher(size_t threads) : pool(threads) { }
+
+    Batch prefetch(const std::vector<std::string> &archive_names);
+    static void wait(Batch *batch);
+
+    static Statistics statistics;
+
+private:
+    ThreadPool pool;
+
+    static void prefetch_archive(const std::string &name);
+    static void prefetch_directory(const std::string &name);
+    static void prefetch_zip(const std::string &name);
+};
+
+#endif // HAD_ARCHIVE_PREFETCHER_H
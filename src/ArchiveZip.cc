@@ -41,6 +41,7 @@
 #include "util.h"
 #include "zip_util.h"
 #include "globals.h"
+#include "ZipCompressor.h"
 
 
 #define BUFSIZE 8192
@@ -111,6 +112,16 @@ bool ArchiveZip::commit_xxx() {
         return false;
     }
     
+    if (configuration.jobs > 1 && ZipCompressor::is_supported()) {
+        std::vector<ZipSourcePtr *> sources;
+        for (auto &change : changes) {
+            if (change.status != Change::DELETED && change.source) {
+                sources.push_back(&change.source);
+            }
+        }
+        ZipCompressor(static_cast<size_t>(configuration.jobs), configuration.compression_level).compress(sources);
+    }
+
     auto ok = true;
     
     for (size_t index = 0; index < files.size(); index++) {
@@ -130,7 +141,8 @@ bool ArchiveZip::commit_xxx() {
                 break;
             }
             zip_source_keep(change.source->source);
-            if (zip_file_add(za, file.name.c_str(), change.source->source, 0) < 0) {
+            auto new_index = zip_file_add(za, file.name.c_str(), change.source->source, 0);
+            if (new_index < 0) {
                 zip_source_free(change.source->source);
                 if (change.source_name.empty()) {
                     output.archive_file_error("error adding empty file: %s", zip_strerror(za));
@@ -141,6 +153,7 @@ bool ArchiveZip::commit_xxx() {
                 ok = false;
                 break;
             }
+            set_compression(static_cast<uint64_t>(new_index), change.source.get());
         }
         else {
             if (!change.original_name.empty()) {
@@ -167,6 +180,7 @@ bool ArchiveZip::commit_xxx() {
                     ok = false;
                     break;
                 }
+                set_compression(index, change.source.get());
             }
         }
     }
@@ -269,6 +283,39 @@ ZipSourcePtr ArchiveZip::get_source(uint64_t index, uint64_t start, std::optiona
 }
 
 
+void ArchiveZip::set_compression(uint64_t index, const ZipSource *source) {
+    if (configuration.compression_level == 9) {
+        // libzip's default
+        return;
+    }
+
+    zip_stat_t st;
+    zip_stat_init(&st);
+    if (zip_source_stat(source->source, &st) == 0 && (st.valid & ZIP_STAT_COMP_METHOD) != 0 && st.comp_method != ZIP_CM_STORE) {
+        // compressed data is copied as is
+        return;
+    }
+
+    zip_set_file_compression(za, index, ZIP_CM_DEFLATE, static_cast<zip_uint32_t>(configuration.compression_level));
+}
+
+
+ZipSourcePtr ArchiveZip::get_compressed_source(uint64_t index) {
+    if (!ensure_zip()) {
+        throw Exception();
+    }
+
+    // libzip copies compressed data and CRC as is when compression method is unchanged
+    auto source = zip_source_zip_create(za, index, ZIP_FL_UNCHANGED | ZIP_FL_COMPRESSED, 0, -1, nullptr);
+
+    if (source == nullptr) {
+        throw Exception("%s", zip_strerror(za));
+    }
+
+    return std::make_shared<ZipSource>(source);
+}
+
+
 bool ArchiveZip::ensure_file_doesnt_exist(const std::string &filename) {
     auto index = zip_name_locate(za, filename.c_str(), 0);
 
@@ -59,9 +59,11 @@ protected:
     zip_t *za;
     
     ZipSourcePtr get_source(uint64_t index, uint64_t start, std::optional<uint64_t> length) override;
+    ZipSourcePtr get_compressed_source(uint64_t index) override;
     bool ensure_zip();
     
     bool ensure_file_doesnt_exist(const std::string &name);
+    void set_compression(uint64_t index, const ZipSource *source);
 };
 
 #endif // _HAD_ARCHIVE_ZIP_H
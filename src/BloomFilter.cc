@@ -0,0 +1,87 @@
+/*
+BloomFilter.cc -- probabilistic set membership test
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "BloomFilter.h"
+
+// With at least 16 bits per element and 3 hashes, less than 0.5% of lookups for absent keys are false positives.
+const size_t BloomFilter::BITS_PER_ELEMENT = 16;
+const size_t BloomFilter::NUMBER_OF_HASHES = 3;
+
+
+BloomFilter::BloomFilter(size_t expected_elements) {
+    uint64_t size = 64;
+    while (size < expected_elements * BITS_PER_ELEMENT) {
+        size <<= 1;
+    }
+
+    bits.resize(size / 64);
+    mask = size - 1;
+}
+
+
+void BloomFilter::add(uint64_t key) {
+    auto hash = mix(key);
+    auto h1 = hash & 0xffffffff;
+    auto h2 = (hash >> 32) | 1;
+
+    for (size_t i = 0; i < NUMBER_OF_HASHES; i++) {
+        auto bit = (h1 + i * h2) & mask;
+        bits[bit / 64] |= static_cast<uint64_t>(1) << (bit % 64);
+    }
+}
+
+
+bool BloomFilter::may_contain(uint64_t key) const {
+    auto hash = mix(key);
+    auto h1 = hash & 0xffffffff;
+    auto h2 = (hash >> 32) | 1;
+
+    for (size_t i = 0; i < NUMBER_OF_HASHES; i++) {
+        auto bit = (h1 + i * h2) & mask;
+        if ((bits[bit / 64] & (static_cast<uint64_t>(1) << (bit % 64))) == 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// splitmix64 finalizer, spreads similar keys over the whole range
+uint64_t BloomFilter::mix(uint64_t key) {
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111eb;
+    key ^= key >> 31;
+    return key;
+}
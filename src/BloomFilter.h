@@ -0,0 +1,58 @@
+#ifndef HAD_BLOOM_FILTER_H
+#define HAD_BLOOM_FILTER_H
+
+/*
+BloomFilter.h -- probabilistic set membership test
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Set of 64 bit keys that may report false positives, but never false negatives.
+class BloomFilter {
+public:
+    explicit BloomFilter(size_t expected_elements);
+
+    void add(uint64_t key);
+    [[nodiscard]] bool may_contain(uint64_t key) const;
+
+private:
+    static const size_t BITS_PER_ELEMENT;
+    static const size_t NUMBER_OF_HASHES;
+
+    std::vector<uint64_t> bits;
+    uint64_t mask;
+
+    static uint64_t mix(uint64_t key);
+};
+
+#endif // HAD_BLOOM_FILTER_H
@@ -43,6 +43,7 @@ class CkMame : public Command {
     void global_setup(const ParsedCommandline &commandline) override;
     bool execute(const std::vector<std::string> &arguments) override;
     bool cleanup() override;
+    bool global_cleanup() override;
 
   private:
     std::string game_list;
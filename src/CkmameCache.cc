@@ -44,12 +44,24 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 CkmameCachePtr ckmame_cache;
 
+bool CkmameCache::keep_for_next_set = false;
+std::unordered_map<std::string, CkmameDBPtr> CkmameCache::kept_databases;
+std::unique_ptr<DirectorySnapshot> CkmameCache::kept_directory_snapshot;
+
 CkmameCache::CkmameCache() :
     extra_delete_list(std::make_shared<DeleteList>()),
     needed_delete_list(std::make_shared<DeleteList>()),
     superfluous_delete_list(std::make_shared<DeleteList>()),
     extra_map_done(false),
     needed_map_done(false) {
+    if (configuration.use_directory_snapshot) {
+        if (kept_directory_snapshot) {
+            directory_snapshot = std::move(kept_directory_snapshot);
+        }
+        else {
+            directory_snapshot = std::make_unique<DirectorySnapshot>(DirectorySnapshot::default_file_name());
+        }
+    }
 }
 
 bool CkmameCache::close_all() {
@@ -57,26 +69,91 @@ bool CkmameCache::close_all() {
 
     for (auto &directory : cache_directories) {
 	if (directory.db) {
-	    bool empty = directory.db->is_empty();
-	    std::string filename = sqlite3_db_filename(directory.db->db, "main");
-
-	    directory.db = nullptr;
-	    if (empty) {
-		std::error_code ec;
-		std::filesystem::remove(filename);
-		if (ec) {
-		    output.error("can't remove empty database '%s': %s", filename.c_str(), ec.message().c_str());
-		    ok = false;
-		}
+	    try {
+		directory.db->flush();
+	    }
+	    catch (Exception &e) {
+		output.error_database("can't write cache database for '%s': %s", directory.name.c_str(), e.what());
+		ok = false;
+	    }
+	    if (keep_for_next_set && is_extra_directory(directory.name)) {
+		kept_databases[directory.name] = directory.db;
 	    }
+	    else if (!close_db(directory.db)) {
+		ok = false;
+	    }
+	    directory.db = nullptr;
 	}
 	directory.initialized = false;
     }
 
+    if (keep_for_next_set) {
+        if (directory_snapshot) {
+            kept_directory_snapshot = std::move(directory_snapshot);
+        }
+        return ok;
+    }
+
+    if (directory_snapshot && !directory_snapshot->write()) {
+        ok = false;
+    }
+
+    return ok;
+}
+
+
+bool CkmameCache::release_kept() {
+    auto ok = true;
+
+    for (auto &entry : kept_databases) {
+        if (!close_db(entry.second)) {
+            ok = false;
+        }
+    }
+    kept_databases.clear();
+
+    if (kept_directory_snapshot && !kept_directory_snapshot->write()) {
+        ok = false;
+    }
+    kept_directory_snapshot = nullptr;
+
     return ok;
 }
 
 
+// Release db and remove its file if it's empty.
+bool CkmameCache::close_db(CkmameDBPtr &db) {
+    bool empty = db->is_empty();
+    std::string filename = sqlite3_db_filename(db->db, "main");
+
+    db = nullptr;
+    if (empty) {
+	std::error_code ec;
+	std::filesystem::remove(filename);
+	if (ec) {
+	    output.error("can't remove empty database '%s': %s", filename.c_str(), ec.message().c_str());
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+
+bool CkmameCache::is_extra_directory(const std::string &name) {
+    for (auto extra_name : configuration.extra_directories) {
+        if (!extra_name.empty() && extra_name[extra_name.length() - 1] == '/') {
+            extra_name.pop_back();
+        }
+        if (extra_name == name) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
 CkmameDBPtr CkmameCache::get_db_for_archive(const std::string &name) {
     auto directory = get_directory_for_archive(name);
 
@@ -110,6 +187,13 @@ const CkmameCache::CacheDirectory* CkmameCache::get_directory_for_archive(const
 		    return nullptr;
 		}
 
+		auto it = kept_databases.find(directory.name);
+		if (it != kept_databases.end()) {
+		    directory.db = it->second;
+		    kept_databases.erase(it);
+		    return &directory;
+		}
+
 		try {
 		    directory.db = std::make_shared<CkmameDB>(directory.name);
 		}
@@ -171,6 +255,7 @@ void CkmameCache::ensure_extra_maps() {
 	switch ((name_type(file))) {
 	case NAME_IMAGES:
 	case NAME_ZIP: {
+            check_interrupted();
             if (siginfo_caught) {
                 print_info("currently scanning '" + file + "'");
             }
@@ -248,7 +333,7 @@ bool CkmameCache::enter_dir_in_map_and_list(const DeleteListPtr &list, const std
 
 bool CkmameCache::enter_dir_in_map_and_list_unzipped(const DeleteListPtr &list, const std::string &directory_name, where_t where) {
     try {
-	Dir dir(directory_name, false);
+	Dir dir(directory_name, false, ckmame_cache ? ckmame_cache->directory_snapshot.get() : nullptr);
 	std::filesystem::path filepath;
 
 	while (!(filepath = dir.next()).empty()) {
@@ -256,6 +341,7 @@ bool CkmameCache::enter_dir_in_map_and_list_unzipped(const DeleteListPtr &list,
 		continue;
 	    }
 	    if (std::filesystem::is_directory(filepath)) {
+                check_interrupted();
                 if (siginfo_caught) {
                     print_info("currently scanning '" + filepath.string() + "'");
                 }
@@ -285,7 +371,7 @@ bool CkmameCache::enter_dir_in_map_and_list_unzipped(const DeleteListPtr &list,
 
 bool CkmameCache::enter_dir_in_map_and_list_zipped(const DeleteListPtr &list, const std::string &dir_name, where_t where) {
     try {
-	Dir dir(dir_name, true);
+	Dir dir(dir_name, true, ckmame_cache ? ckmame_cache->directory_snapshot.get() : nullptr);
 	std::filesystem::path filepath;
 
 	while (!(filepath = dir.next()).empty()) {
@@ -314,6 +400,7 @@ bool CkmameCache::enter_file_in_map_and_list(const DeleteListPtr &list, const st
     switch ((nt = name_type(name))) {
     case NAME_IMAGES:
     case NAME_ZIP: {
+        check_interrupted();
         if (siginfo_caught) {
             print_info("currently scanning '" + name + "'");
         }
@@ -34,10 +34,12 @@ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
 IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <unordered_map>
 #include <unordered_set>
 
 #include "CkmameDB.h"
 #include "DeleteList.h"
+#include "DirectorySnapshot.h"
 #include "Stats.h"
 
 class CkmameCache {
@@ -54,12 +56,19 @@ class CkmameCache {
 
     void used(Archive *a, size_t idx);
 
+    // Keep cache databases of extra directories and the directory snapshot open for the next set checked in this run.
+    static bool keep_for_next_set;
+    // Close and write everything kept for the next set.
+    static bool release_kept();
+
     DeleteListPtr extra_delete_list;
     DeleteListPtr needed_delete_list;
     DeleteListPtr superfluous_delete_list;
 
     std::unordered_set<std::string> complete_games;
 
+    std::unique_ptr<DirectorySnapshot> directory_snapshot;
+
     Stats stats;
 
   private:
@@ -73,6 +82,11 @@ class CkmameCache {
     };
 
     bool close_all();
+    static bool close_db(CkmameDBPtr &db);
+    static bool is_extra_directory(const std::string &name);
+
+    static std::unordered_map<std::string, CkmameDBPtr> kept_databases;
+    static std::unique_ptr<DirectorySnapshot> kept_directory_snapshot;
 
     std::vector<CacheDirectory> cache_directories;
 
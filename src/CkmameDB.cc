@@ -39,9 +39,15 @@
     #include "Detector.h"
     #include "Exception.h"
     #include "fix.h"
+    #include "sighandle.h"
+
+    // Changes are collected in one transaction and committed after this many archives.
+    #define WRITE_BATCH_SIZE 1000
 
     const std::string CkmameDB::db_name = ".ckmame.db";
 
+    const size_t CkmameDB::PRELOAD_THRESHOLD = 64;
+
     const DB::DBFormat CkmameDB::format = {
 	0x02,
 	4,
@@ -107,7 +113,9 @@
 	{ INSERT_DETECTOR, "insert into detector (detector_id, name, version) values (:detector_id, :name, :version)" },
 	{ INSERT_FILE, "insert into file (archive_id, file_idx, detector_id, name, mtime, status, size, crc, md5, sha1) values (:archive_id, :file_idx, :detector_id, :name, :mtime, :status, :size, :crc, :md5, :sha1)" },
 	{ LIST_ARCHIVES, "select name, file_type from archive" },
+	{ LIST_ARCHIVES_FULL, "select archive_id, name, file_type, mtime, size from archive" },
 	{ LIST_DETECTORS, "select detector_id, name, version from detector" },
+	{ LIST_FILES, "select archive_id, file_idx, detector_id, name, mtime, status, size, crc, md5, sha1 from file order by archive_id, file_idx, detector_id" },
 	{ QUERY_ARCHIVE_ID, "select archive_id from archive where name = :name and file_type = :file_type" },
 	{ QUERY_ARCHIVE_LAST_CHANGE, "select mtime, size from archive where archive_id = :archive_id" },
 	{ QUERY_FILE, "select file_idx, detector_id, name, mtime, status, size, crc, md5, sha1 from file where archive_id = :archive_id order by file_idx, detector_id" },
@@ -117,7 +125,7 @@
     CkmameDB::CkmameDB(const std::string& directory) : CkmameDB(make_db_file_name(directory, db_name, configuration.extra_directory_use_central_cache_directory(directory)), directory) {
     }
 
-    CkmameDB::CkmameDB(const std::string &dbname, std::string directory_) : DB(format, dbname, DBH_CREATE | DBH_WRITE), directory(std::move(directory_)) {
+    CkmameDB::CkmameDB(const std::string &dbname, std::string directory_) : DB(format, dbname, DBH_CREATE | DBH_WRITE), directory(std::move(directory_)), pending_writes(0), lookups(0), preloaded(false) {
 	auto stmt = get_statement(LIST_DETECTORS);
 
 	while (stmt->step()) {
@@ -126,6 +134,16 @@
     }
 
 
+    CkmameDB::~CkmameDB() {
+	try {
+	    flush();
+	}
+	catch (Exception &e) {
+	    output.error_database("can't write cache database for '%s': %s", directory.c_str(), e.what());
+	}
+    }
+
+
     std::string CkmameDB::get_query(int name, bool parameterized) const {
 	if (parameterized) {
 	    return "";
@@ -141,12 +159,28 @@
 
 
     void CkmameDB::delete_archive(int id) {
+	begin_write();
+
 	delete_files(id);
 
 	auto stmt = get_statement(DELETE_ARCHIVE);
 
 	stmt->set_int("archive_id", id);
 	stmt->execute();
+
+	if (preloaded) {
+	    auto it = preloaded_archives.find(id);
+	    if (it != preloaded_archives.end()) {
+		auto &ids = preloaded_ids[it->second.filetype];
+		auto it_id = ids.find(it->second.name);
+		if (it_id != ids.end() && it_id->second == id) {
+		    ids.erase(it_id);
+		}
+		preloaded_archives.erase(it);
+	    }
+	}
+
+	end_write();
     }
 
 
@@ -157,6 +191,31 @@
     }
 
 
+    void CkmameDB::begin_write() {
+	if (!in_transaction()) {
+	    begin_transaction();
+	}
+    }
+
+
+    void CkmameDB::end_write() {
+	pending_writes += 1;
+
+	// Don't lose work done so far when interrupted.
+	if (pending_writes >= WRITE_BATCH_SIZE || sigint_caught) {
+	    flush();
+	}
+    }
+
+
+    void CkmameDB::flush() {
+	if (in_transaction()) {
+	    commit_transaction();
+	}
+	pending_writes = 0;
+    }
+
+
     void CkmameDB::delete_files(int id) {
 	auto stmt = get_statement(DELETE_FILE);
 
@@ -165,12 +224,21 @@
     }
 
 
-    int CkmameDB::get_archive_id(const std::string &name, filetype_t filetype) {
+    int CkmameDB::get_archive_id(const std::string &name, filetype_t filetype, bool peek) {
 	auto archive_name = name_in_db(name);
 	if (archive_name.empty()) {
 	return 0;
 	}
 
+	if (!preloaded && !peek && ++lookups == PRELOAD_THRESHOLD) {
+	    // probably checking whole directory
+	    preload();
+	}
+	if (preloaded) {
+	    auto it = preloaded_ids[filetype].find(archive_name);
+	    return it == preloaded_ids[filetype].end() ? 0 : it->second;
+	}
+
 	auto stmt = get_statement(QUERY_ARCHIVE_ID);
 
 	stmt->set_string("name", archive_name);
@@ -185,6 +253,15 @@
 
 
     void CkmameDB::get_last_change(int id, time_t *mtime, off_t *size) {
+	if (preloaded) {
+	    auto it = preloaded_archives.find(id);
+	    if (it != preloaded_archives.end()) {
+		*mtime = it->second.mtime;
+		*size = it->second.size;
+		return;
+	    }
+	}
+
 	auto stmt = get_statement(QUERY_ARCHIVE_LAST_CHANGE);
 
 	stmt->set_int("archive_id", id);
@@ -220,11 +297,68 @@
     }
 
 
-    int CkmameDB::read_files(int archive_id, std::vector<File> *files) {
+    void CkmameDB::preload() {
+	preloaded_archives.clear();
+	for (auto &ids : preloaded_ids) {
+	    ids.clear();
+	}
+
+	auto stmt = get_statement(LIST_ARCHIVES_FULL);
+
+	while (stmt->step()) {
+	    auto id = stmt->get_int("archive_id");
+	    auto name = stmt->get_string("name");
+	    auto filetype = stmt->get_int("file_type");
+
+	    if (filetype < 0 || filetype >= TYPE_MAX) {
+		continue;
+	    }
+	    // like QUERY_ARCHIVE_ID, use first of duplicate entries
+	    preloaded_ids[filetype].emplace(name, id);
+	    preloaded_archives.emplace(id, PreloadedArchive(name, static_cast<filetype_t>(filetype), stmt->get_int64("mtime"), stmt->get_int64("size")));
+	}
+
+	stmt = get_statement(LIST_FILES);
+
+	auto current_id = 0;
+	std::vector<File> *files = nullptr;
+
+	while (stmt->step()) {
+	    auto id = stmt->get_int("archive_id");
+
+	    if (id != current_id) {
+		current_id = id;
+		auto it = preloaded_archives.find(id);
+		files = it == preloaded_archives.end() ? nullptr : &it->second.files;
+	    }
+	    if (files != nullptr) {
+		read_file(stmt, files);
+	    }
+	}
+
+	preloaded = true;
+    }
+
+
+    int CkmameDB::read_files(int archive_id, std::vector<File> *files, bool peek) {
 	if (archive_id == 0) {
 	    return 0;
 	}
 
+	if (preloaded) {
+	    auto it = preloaded_archives.find(archive_id);
+	    if (it != preloaded_archives.end() && it->second.have_files) {
+		if (peek) {
+		    *files = it->second.files;
+		    return archive_id;
+		}
+		*files = std::move(it->second.files);
+		it->second.files = {};
+		it->second.have_files = false;
+		return archive_id;
+	    }
+	}
+
 	auto stmt = get_statement(QUERY_FILE);
 
 	stmt->set_int("archive_id", archive_id);
@@ -232,32 +366,37 @@
 	files->clear();
 
 	while (stmt->step()) {
-	    auto detector_id = stmt->get_uint64("detector_id");
+	    read_file(stmt, files);
+	}
+
+	return archive_id;
+    }
 
-	    if (detector_id == 0) {
-		// There is exactly one entry per file_idx with detector_id 0, which is retrieved in order.
-		File file;
 
-		file.name = stmt->get_string("name");
-		file.mtime = stmt->get_int64("mtime");
-		file.broken = stmt->get_int("status");
-		file.hashes = stmt->get_hashes();
-		file.hashes.size = stmt->get_uint64("size", Hashes::SIZE_UNKNOWN);
+    void CkmameDB::read_file(DBStatement *stmt, std::vector<File> *files) {
+	auto detector_id = stmt->get_uint64("detector_id");
 
-		files->push_back(file);
-	    }
-	    else {
-		auto file_id = stmt->get_uint64("file_idx");
-		auto global_detector_id = get_global_detector_id(detector_id);
+	if (detector_id == 0) {
+	    // There is exactly one entry per file_idx with detector_id 0, which is retrieved in order.
+	    File file;
 
-		Hashes hashes = stmt->get_hashes();
-		hashes.size = stmt->get_uint64("size", Hashes::SIZE_UNKNOWN);
+	    file.name = stmt->get_string("name");
+	    file.mtime = stmt->get_int64("mtime");
+	    file.broken = stmt->get_int("status");
+	    file.hashes = stmt->get_hashes();
+	    file.hashes.size = stmt->get_uint64("size", Hashes::SIZE_UNKNOWN);
 
-		(*files)[file_id].detector_hashes[global_detector_id] = hashes;
-	    }
+	    files->push_back(file);
 	}
+	else {
+	    auto file_id = stmt->get_uint64("file_idx");
+	    auto global_detector_id = get_global_detector_id(detector_id);
 
-	return archive_id;
+	    Hashes hashes = stmt->get_hashes();
+	    hashes.size = stmt->get_uint64("size", Hashes::SIZE_UNKNOWN);
+
+	    (*files)[file_id].detector_hashes[global_detector_id] = hashes;
+	}
     }
 
 
@@ -267,6 +406,8 @@
 
 
     void CkmameDB::write_archive(ArchiveContents *archive) {
+	begin_write();
+
 	auto id = archive->cache_id;
 
 	if (id == 0) {
@@ -282,7 +423,15 @@
 	    throw Exception();
 	}
 
-	id = write_archive_header(id, name, archive->filetype, archive->flags & ARCHIVE_FL_TOP_LEVEL_ONLY ? 0 : archive->mtime, archive->size);
+	auto mtime = archive->flags & ARCHIVE_FL_TOP_LEVEL_ONLY ? 0 : archive->mtime;
+	id = write_archive_header(id, name, archive->filetype, mtime, archive->size);
+
+	if (preloaded) {
+	    preloaded_ids[archive->filetype].emplace(name, id);
+	    auto &preloaded_archive = preloaded_archives.emplace(id, PreloadedArchive(name, archive->filetype, mtime, static_cast<off_t>(archive->size))).first->second;
+	    // files are in the archive contents already
+	    preloaded_archive.have_files = false;
+	}
 
 	auto stmt = get_statement(INSERT_FILE);
 
@@ -319,6 +468,8 @@
 	}
 
 	archive->cache_id = id;
+
+	end_write();
     }
 
 
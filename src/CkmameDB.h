@@ -35,6 +35,7 @@
 
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -58,7 +59,9 @@ public:
         INSERT_DETECTOR,
         INSERT_FILE,
         LIST_ARCHIVES,
+        LIST_ARCHIVES_FULL,
         LIST_DETECTORS,
+        LIST_FILES,
         QUERY_ARCHIVE_ID,
         QUERY_ARCHIVE_LAST_CHANGE,
         QUERY_FILE,
@@ -67,18 +70,22 @@ public:
     
     explicit CkmameDB(const std::string& directory);
     CkmameDB(const std::string& dbname, std::string directory); // used in dbrestore
-    ~CkmameDB() override = default;
+    ~CkmameDB() override;
 
     static const DBFormat format;
     static const std::string db_name;
 
     void delete_archive(const std::string &name, filetype_t filetype);
     void delete_archive(int id);
-    int get_archive_id(const std::string &name, filetype_t filetype);
+    // With peek, the lookup doesn't count towards preloading.
+    int get_archive_id(const std::string &name, filetype_t filetype, bool peek = false);
     void get_last_change(int id, time_t *mtime, off_t *size);
+    void flush();
     bool is_empty();
     std::vector<ArchiveLocation> list_archives();
-    int read_files(int archive_id, std::vector<File> *files);
+    void preload();
+    // With peek, preloaded files are copied instead of handed out.
+    int read_files(int archive_id, std::vector<File> *files, bool peek = false);
     void write_archive(ArchiveContents *archive);
     
     void seterr();
@@ -87,15 +94,39 @@ protected:
     [[nodiscard]] std::string get_query(int name, bool parameterized) const override;
     
 private:
+    // Archive and its files as read by preload().
+    class PreloadedArchive {
+    public:
+        PreloadedArchive(std::string name_, filetype_t filetype_, time_t mtime_, off_t size_) : name(std::move(name_)), filetype(filetype_), mtime(mtime_), size(size_), have_files(true) { }
+
+        std::string name;
+        filetype_t filetype;
+        time_t mtime;
+        off_t size;
+        bool have_files; // files are handed out only once, later reads go to the database
+        std::vector<File> files;
+    };
+
     static std::unordered_map<Statement, std::string> queries;
 
     std::string directory;
     DetectorCollection detector_ids;
+    size_t pending_writes; // changes in current transaction
+
+    // After this many archive lookups, all archives are read at once.
+    static const size_t PRELOAD_THRESHOLD;
+    size_t lookups;
+    bool preloaded;
+    std::unordered_map<std::string, int> preloaded_ids[TYPE_MAX];
+    std::unordered_map<int, PreloadedArchive> preloaded_archives;
     
     DBStatement *get_statement(Statement name) { return get_statement_internal(name); }
 
     std::string name_in_db(const std::string &name);
+    void begin_write();
+    void end_write();
     void delete_files(int id);
+    void read_file(DBStatement *stmt, std::vector<File> *files);
     int write_archive_header(int id, const std::string &name, filetype_t filetype, time_t mtime, uint64_t size);
     
     size_t get_detector_id(size_t global_id);
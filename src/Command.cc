@@ -46,7 +46,8 @@ Command::Command(std::string name, std::string arguments, std::vector<Commandlin
     : name(std::move(name)),
       arguments(std::move(arguments)),
       options(std::move(options)),
-      used_variables(std::move(used_variables)) {}
+      used_variables(std::move(used_variables)),
+      multi_set_invocation(false) {}
 
 
 int Command::run(int argc, char* const* argv) {
@@ -108,14 +109,14 @@ int Command::run(int argc, char* const* argv) {
         }
 
         if (selected_sets.empty()) {
-            if (!do_for("", arguments, false)) {
+            if (!do_for("", arguments)) {
                 exit_code = 1;
             }
         }
         else {
-            auto multi_set = selected_sets.size() > 1;
+            multi_set_invocation = selected_sets.size() > 1;
             for (const auto& set : selected_sets) {
-                if (!do_for(set, arguments, multi_set)) {
+                if (!do_for(set, arguments)) {
                     exit_code = 1;
                 }
             }
@@ -145,7 +146,7 @@ int Command::run(int argc, char* const* argv) {
 }
 
 
-bool Command::do_for(const std::string& set, const ParsedCommandline& arguments, bool multi_set_invocation) {
+bool Command::do_for(const std::string& set, const ParsedCommandline& arguments) {
     try {
         if (multi_set_invocation) {
             output.set_header("Set " + set);
@@ -56,9 +56,11 @@ class Command {
     std::string arguments;
     std::vector<Commandline::Option> options;
     std::unordered_set<std::string> used_variables;
+    // More than one set is checked in this run, one after the other.
+    bool multi_set_invocation;
 
   private:
-    bool do_for(const std::string& set, const ParsedCommandline& arguments, bool multi_set_invocation = false);
+    bool do_for(const std::string& set, const ParsedCommandline& arguments);
 };
 
 
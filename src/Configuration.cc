@@ -90,6 +90,7 @@ TomlSchema::TypePtr Configuration::extra_directories_schema = TomlSchema::altern
 TomlSchema::TypePtr Configuration::section_schema = TomlSchema::table({
     { "complete-games-only", TomlSchema::boolean() },
     { "complete-list", TomlSchema::string() },
+    { "compression-level", TomlSchema::integer() },
     { "create-fixdat",  TomlSchema::boolean() },
     { "dat-directories", dat_directories_schema },
     { "dat-directories-append", dat_directories_schema },
@@ -97,10 +98,12 @@ TomlSchema::TypePtr Configuration::section_schema = TomlSchema::table({
     { "extra-directories", extra_directories_schema},
     { "extra-directories-append", extra_directories_schema},
     { "fixdat-directory",  TomlSchema::string() },
+    { "jobs", TomlSchema::integer() },
     { "keep-old-duplicate",  TomlSchema::boolean() },
     { "missing-list", TomlSchema::string() },
     { "move-from-extra",  TomlSchema::boolean() },
     { "old-db", TomlSchema::string() },
+    { "prefetch-depth", TomlSchema::integer() },
     { "profiles", TomlSchema::array(TomlSchema::string()) },
     { "report-correct",  TomlSchema::boolean() },
     { "report-detailed",  TomlSchema::boolean() },
@@ -110,6 +113,7 @@ TomlSchema::TypePtr Configuration::section_schema = TomlSchema::table({
     { "report-summary",  TomlSchema::boolean() },
     { "rom-directory", TomlSchema::string() },
     { "rom-db", TomlSchema::string() },
+    { "rom-db-snapshot",  TomlSchema::boolean() },
     { "roms-zipped",  TomlSchema::boolean() },
     { "saved-directory", TomlSchema::string() },
     { "sets", TomlSchema::array(TomlSchema::string()) },
@@ -118,6 +122,7 @@ TomlSchema::TypePtr Configuration::section_schema = TomlSchema::table({
     { "update-database",  TomlSchema::boolean() },
     { "use-central-cache-directory", TomlSchema::boolean() },
     { "use-description-as-name",  TomlSchema::boolean() },
+    { "use-directory-snapshot",  TomlSchema::boolean() },
     { "use-temp-directory",  TomlSchema::boolean() },
     { "verbose",  TomlSchema::boolean() }
 }, {});
@@ -136,6 +141,7 @@ std::vector<Commandline::Option> Configuration::commandline_options = {
     Commandline::Option("create-fixdat", "write fixdat to 'fix_$NAME_OF_SET.dat'"),
     Commandline::Option("extra-directory", 'e', "dir", "search for missing files in directory dir (multiple directories can be specified by repeating this option)"),
     Commandline::Option("fixdat-directory", "directory", "create fixdats in directory"),
+    Commandline::Option("jobs", "n", "use n threads for computing hashes, compressing files, and writing databases (default: 1)"),
     Commandline::Option("keep-old-duplicate", "keep files in ROM set that are also in old ROMs"),
     Commandline::Option("list-sets", "list all known sets"),
     Commandline::Option("missing-list", "file", "write list of missing games to file"),
@@ -157,6 +163,7 @@ std::vector<Commandline::Option> Configuration::commandline_options = {
     Commandline::Option("report-no-good-dump", "don't suppress reporting status of ROMs for which no good dump exists"),
     Commandline::Option("report-summary", "print summary of ROM set status"),
     Commandline::Option("rom-db", 'D', "dbfile", "use ROM database dbfile"),
+    Commandline::Option("rom-db-snapshot", "write snapshot of ROM database for faster reading"),
     Commandline::Option("rom-directory", 'R', "dir", "ROM set is in directory dir (default: 'roms')"),
     Commandline::Option("roms-unzipped", "ROMs are files on disk, not contained in zip archives"),
     Commandline::Option("saved-directory", "directory", "save needed ROMs in directory (default: 'saved')"),
@@ -229,11 +236,14 @@ Configuration::Configuration() : fix_romset(false) {
 void Configuration::reset() {
     complete_games_only = false;
     complete_list = "";
+    compression_level = 9;
     create_fixdat = false;
+    jobs = 1;
     keep_old_duplicate = false;
     missing_list = "";
     move_from_extra = false;
     old_db = RomDB::default_old_name();
+    prefetch_depth = 0;
     report_correct = false;
     report_detailed = false;
     report_fixable = true;
@@ -241,6 +251,7 @@ void Configuration::reset() {
     report_no_good_dump = false;
     report_summary = false;
     rom_db = RomDB::default_name();
+    rom_db_snapshot = false;
     rom_directory = "roms";
     roms_zipped = true;
     saved_directory = "saved";
@@ -251,6 +262,7 @@ void Configuration::reset() {
     update_database = false;
     use_central_cache_directory = false;
     use_description_as_name = false;
+    use_directory_snapshot = false;
     use_temp_directory = false;
     verbose = false;
     warn_file_known = true;
@@ -387,6 +399,9 @@ void Configuration::prepare(const std::string &current_set, const ParsedCommandl
         else if (option.name == "fixdat-directory") {
             fixdat_directory = option.argument;
         }
+        else if (option.name == "jobs") {
+            jobs = parse_jobs(option.argument);
+        }
         else if (option.name == "keep-old-duplicate") {
             keep_old_duplicate = true;
         }
@@ -447,6 +462,9 @@ void Configuration::prepare(const std::string &current_set, const ParsedCommandl
         else if (option.name == "rom-db") {
             rom_db = option.argument;
         }
+        else if (option.name == "rom-db-snapshot") {
+            rom_db_snapshot = true;
+        }
         else if (option.name == "rom-directory") {
             rom_directory = option.argument;
         }
@@ -506,6 +524,10 @@ void Configuration::merge_config_table(const toml::table *table_pointer) {
 
     set_bool(table, "complete-games-only", complete_games_only);
     set_string(table, "complete-list", complete_list);
+    set_int(table, "compression-level", compression_level);
+    if (compression_level < 1 || compression_level > 9) {
+        throw Exception("invalid compression level %d", compression_level);
+    }
     set_bool(table, "create-fixdat", create_fixdat);
     merge_dat_directories(table, "dat-directories", false);
     merge_dat_directories(table, "dat-directories-append", true);
@@ -514,16 +536,25 @@ void Configuration::merge_config_table(const toml::table *table_pointer) {
     merge_extra_directories(table, "extra-directories", false);
     merge_extra_directories(table, "extra-directories-append", true);
     set_string(table, "fixdat-directory", fixdat_directory);
+    set_int(table, "jobs", jobs);
+    if (jobs < 1) {
+        throw Exception("invalid number of jobs %d", jobs);
+    }
     set_bool(table, "keep-old-duplicate", keep_old_duplicate);
     set_string(table, "missing-list", missing_list);
     set_bool(table, "move-from-extra", move_from_extra);
     set_string(table, "old-db", old_db);
+    set_int(table, "prefetch-depth", prefetch_depth);
+    if (prefetch_depth < 0) {
+        throw Exception("invalid prefetch depth %d", prefetch_depth);
+    }
     set_bool(table, "report-correct", report_correct);
     set_bool(table, "report-detailed", report_detailed);
     set_bool(table, "report-fixable", report_fixable);
     set_bool(table, "report-missing", report_missing);
     set_bool(table, "report-summary", report_summary);
     set_bool(table, "report-no-good-dump", report_no_good_dump);
+    set_bool(table, "rom-db-snapshot", rom_db_snapshot);
     set_string(table, "rom-directory", rom_directory);
     set_bool(table, "roms-zipped", roms_zipped);
     set_string(table, "saved-directory", saved_directory);
@@ -531,6 +562,7 @@ void Configuration::merge_config_table(const toml::table *table_pointer) {
     set_bool(table, "update-database", update_database);
     set_bool(table, "use-central-cache-directory", use_central_cache_directory);
     set_bool(table, "use-description-as-name", use_description_as_name);
+    set_bool(table, "use-directory-snapshot", use_directory_snapshot);
     set_bool(table, "use-temp-directory", use_temp_directory);
     set_bool(table, "verbose", verbose);
 }
@@ -555,6 +587,14 @@ void Configuration::set_bool(const toml::table &table, const std::string &name,
 }
 
 
+void Configuration::set_int(const toml::table &table, const std::string &name, int &variable) {
+    auto value = table[name].value<int>();
+    if (value.has_value()) {
+	variable = value.value();
+    }
+}
+
+
 void Configuration::set_bool_optional(const toml::table &table, const std::string &name, std::optional<bool> &variable){
     auto value = table[name].value<bool>();
     if (value.has_value()) {
@@ -613,6 +653,24 @@ void Configuration::set_string_vector(const toml::table &table, const std::strin
 }
 
 
+int Configuration::parse_jobs(const std::string &argument) {
+    size_t end = 0;
+    int value = 0;
+
+    try {
+        value = std::stoi(argument, &end);
+    }
+    catch (...) {
+        end = 0;
+    }
+    if (end == 0 || end != argument.size() || value < 1) {
+        throw Exception("invalid number of jobs '%s'", argument.c_str());
+    }
+
+    return value;
+}
+
+
 std::string Configuration::replace_variables(std::string string) const {
     auto start = string.find("$set");
     if (start != std::string::npos) {
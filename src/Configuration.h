@@ -93,15 +93,18 @@ public:
     // config variables
     bool complete_games_only; // only add ROMs to games if they are complete afterwards.
     std::string complete_list;
+    int compression_level; // deflate level for files added to zip archives
     bool create_fixdat;
     std::vector<std::string> dat_directories;
     std::vector<std::string> dats;
     std::vector<std::string> extra_directories;
     std::string fixdat_directory;
+    int jobs; // number of threads used for computing hashes, compressing files, and writing databases
     bool keep_old_duplicate;
     std::string missing_list;
     bool move_from_extra; // remove files taken from extra directories, otherwise copy them and don't change extra directory.
     std::string old_db;
+    int prefetch_depth; // number of games whose archives are read ahead
     bool report_correct; /* report ROMs that are correct */
     bool report_detailed; /* one line for each ROM */
     bool report_fixable; /* report ROMs that are not correct but can be fixed */
@@ -109,6 +112,7 @@ public:
     bool report_no_good_dump; /* report ROMs that are not correct and can not be fixed */
     bool report_summary; /* print statistics about ROM set at end of run */
     std::string rom_db;
+    bool rom_db_snapshot; // write read-only snapshot of ROM database next to it
     std::string rom_directory;
     bool roms_zipped;
     std::string saved_directory;
@@ -116,6 +120,7 @@ public:
     bool update_database;
     bool use_central_cache_directory; // create CkmameDB and DatDB in $HOME/.cache/ckmame
     bool use_description_as_name; // in ROM database
+    bool use_directory_snapshot; // keep listings of scanned directories in $HOME/.cache/ckmame/directory-snapshot
     bool use_temp_directory; // create RomDB in temporary directory, then move into place
     bool verbose; // print all actions taken to fix ROM set
 
@@ -158,6 +163,8 @@ private:
     static bool read_config_file(std::vector<toml::table> &config_tables, const std::string &file_name, bool optional);
     void reset();
     static void set_bool(const toml::table &table, const std::string &name, bool &variable);
+    static void set_int(const toml::table &table, const std::string &name, int &variable);
+    static int parse_jobs(const std::string &argument);
     static void set_bool_optional(const toml::table &table, const std::string &name, std::optional<bool>& variable);
     void set_string(const toml::table &table, const std::string &name, std::string &variable);
     void set_string_optional(const toml::table &table, const std::string &name, std::optional<std::string>& variable);
@@ -58,6 +58,7 @@ static const char *format_name[] = {
 #define SET_VERSION_FMT "pragma user_version = %d"
 
 #define PRAGMAS "PRAGMA synchronous = OFF; "
+#define BULK_LOAD_PRAGMAS "PRAGMA journal_mode = MEMORY; PRAGMA cache_size = -65536; "
 
 const std::unordered_map<MigrationVersions, std::string> DB::no_migrations = { };
 
@@ -223,6 +224,29 @@ std::filesystem::path DB::make_db_file_name(const std::filesystem::path &directo
 }
 
 
+void DB::begin_transaction() {
+    if (sqlite3_exec(db, "begin transaction", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        throw Exception("can't begin transaction: %s", sqlite3_errmsg(db));
+    }
+}
+
+
+void DB::enable_bulk_load() {
+    if (sqlite3_exec(db, BULK_LOAD_PRAGMAS, nullptr, nullptr, nullptr) != SQLITE_OK) {
+        throw Exception("can't set options: %s", sqlite3_errmsg(db));
+    }
+}
+
+
+void DB::commit_transaction() {
+    if (sqlite3_exec(db, "commit transaction", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        auto error = std::string(sqlite3_errmsg(db));
+        sqlite3_exec(db, "rollback transaction", nullptr, nullptr, nullptr);
+        throw Exception("can't commit transaction: %s", error.c_str());
+    }
+}
+
+
 void DB::upgrade(int format, int version, const std::string &statement) const {
     upgrade(db, format, version, statement);
 }
@@ -120,6 +120,12 @@ public:
     sqlite3 *db;
     
     [[nodiscard]] std::string error() const;
+
+    void begin_transaction();
+    void commit_transaction();
+    // Keep the journal in memory and use a larger page cache, for filling a new database; it is corrupt if the program crashes.
+    void enable_bulk_load();
+    [[nodiscard]] bool in_transaction() const { return sqlite3_get_autocommit(db) == 0; }
     
     // This is used by dbrestore to create databases with arbitrary schema and version.
     static void upgrade(sqlite3 *db, int format, int version, const std::string &statement);
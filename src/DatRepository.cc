@@ -35,18 +35,26 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <sys/stat.h>
 
+#include <deque>
 #include <set>
 #include <unordered_set>
 
 #include "Dir.h"
 #include "OutputContextHeader.h"
 #include "Parser.h"
-#include "ParserSourceFile.h"
-#include "ParserSourceZip.h"
+#include "ParserSourcePrefix.h"
+#include "SharedFile.h"
+#include "ThreadPool.h"
 #include "util.h"
 #include "Exception.h"
 #include "globals.h"
 
+// Headers of all common dat formats fit, the rest is read only if needed.
+#define HEADER_PREFIX_SIZE (16 * 1024u)
+
+// Number of files read ahead of the parser per thread.
+#define FILES_PER_THREAD 4
+
 DatRepository::DatRepository(const std::vector<std::string> &directories) {
     for (auto const &directory : directories) {
 	if (!std::filesystem::is_directory(directory)) {
@@ -120,80 +128,64 @@ std::vector<std::string> DatRepository::list_dats() {
 void DatRepository::update_directory(const std::string &directory, const DatDBPtr &db) {
     auto dir = Dir(directory, true);
     std::unordered_set<std::string> files;
+    std::deque<std::shared_ptr<ScannedFile>> pending;
     std::filesystem::path filepath;
 
+    std::unique_ptr<ThreadPool> thread_pool;
+    if (configuration.jobs > 1) {
+        thread_pool = std::make_unique<ThreadPool>(static_cast<size_t>(configuration.jobs));
+    }
+    auto read_ahead = thread_pool ? thread_pool->size() * FILES_PER_THREAD : 1;
+
+    db->begin_transaction();
+
     while ((filepath = dir.next()) != "") {
 	try {
 	    if (directory == filepath || name_type(filepath) == NAME_IGNORE || !std::filesystem::is_regular_file(filepath)) {
 		continue;
 	    }
 
-	    auto file = filepath.string().substr(directory.size() + 1);
-
-	    struct stat st{};
+	    auto scanned_file = std::make_shared<ScannedFile>();
+	    scanned_file->file = filepath.string().substr(directory.size() + 1);
+	    scanned_file->filepath = filepath;
 
-	    if (stat(filepath.c_str(), &st) < 0) {
+	    if (stat(filepath.c_str(), &scanned_file->st) < 0) {
 		continue;
 	    }
 
-	    files.insert(file);
+	    files.insert(scanned_file->file);
 
 	    time_t db_mtime;
 	    size_t db_size;
 
-	    if (db->get_last_change(file, &db_mtime, &db_size)) {
-		if (db_mtime == st.st_mtime && db_size == static_cast<size_t>(st.st_size)) {
+	    if (db->get_last_change(scanned_file->file, &db_mtime, &db_size)) {
+		if (db_mtime == scanned_file->st.st_mtime && db_size == static_cast<size_t>(scanned_file->st.st_size)) {
 		    continue;
 		}
-		db->delete_file(file);
+		db->delete_file(scanned_file->file);
 	    }
 
-	    std::vector<DatDB::DatEntry> entries;
-
-	    try {
-		auto zip_archive = zip_open(filepath.c_str(), 0, nullptr);
-		if (zip_archive != nullptr) {
-		    for (size_t index = 0; static_cast<int64_t>(index) < zip_get_num_entries(zip_archive, 0); index++) {
-			try {
-			    auto entry_name = zip_get_name(zip_archive, index, 0);
-			    auto output = OutputContextHeader();
-
-			    auto source = std::make_shared<ParserSourceZip>(filepath, zip_archive, entry_name);
-			    auto parser = Parser::create(source, {}, nullptr, &output, {});
-			    if (parser) {
-				if (parser->parse_header()) {
-				    auto header = output.get_header();
-				    entries.emplace_back(entry_name, header.name, header.version);
-				}
-			    }
-			}
-			catch (Exception &ex) {
-
-			}
-		    }
-		}
-		else {
-		    auto output = OutputContextHeader();
-
-		    auto source = std::make_shared<ParserSourceFile>(filepath);
-		    auto parser = Parser::create(source, {}, nullptr, &output, {});
-
-		    if (parser) {
-			if (parser->parse_header() && output.close()) {
-			    auto header = output.get_header();
-			    entries.emplace_back("", header.name, header.version);
-			}
-		    }
-		}
+	    if (thread_pool) {
+		scanned_file->done = thread_pool->submit([scanned_file]() { scanned_file->read_prefixes(); });
 	    }
-	    catch (Exception &ex) {
-		// TODO: warn or ignore?
+	    else {
+		scanned_file->read_prefixes();
 	    }
-	    db->insert_file(file, st.st_mtime, st.st_size, entries);
+	    pending.push_back(scanned_file);
 	}
 	catch (Exception &ex) {
 	    output.error("can't process '%s': %s", filepath.c_str(), ex.what());
 	}
+
+	while (pending.size() >= read_ahead) {
+	    insert_file(db, pending.front().get());
+	    pending.pop_front();
+	}
+    }
+
+    while (!pending.empty()) {
+	insert_file(db, pending.front().get());
+	pending.pop_front();
     }
 
     auto db_files = db->list_files();
@@ -203,6 +195,93 @@ void DatRepository::update_directory(const std::string &directory, const DatDBPt
 	    db->delete_file(file);
 	}
     }
+
+    db->commit_transaction();
+}
+
+
+void DatRepository::insert_file(const DatDBPtr &db, ScannedFile *file) {
+    std::vector<DatDB::DatEntry> entries;
+
+    if (file->done.valid()) {
+	file->done.get();
+    }
+
+    try {
+	for (auto &entry : file->entries) {
+	    try {
+		auto output = OutputContextHeader();
+
+		auto source = std::make_shared<ParserSourcePrefix>(file->is_zip ? file->filepath.string() : "", file->is_zip ? entry.name : file->filepath.string(), entry.mtime, std::move(entry.prefix), entry.complete);
+		auto parser = Parser::create(source, {}, nullptr, &output, {});
+		if (parser) {
+		    if (parser->parse_header() && (file->is_zip || output.close())) {
+			auto header = output.get_header();
+			entries.emplace_back(entry.name, header.name, header.version);
+		    }
+		}
+	    }
+	    catch (Exception &ex) {
+		if (!file->is_zip) {
+		    throw;
+		}
+	    }
+	}
+    }
+    catch (Exception &ex) {
+	// TODO: warn or ignore?
+    }
+
+    try {
+	db->insert_file(file->file, file->st.st_mtime, static_cast<size_t>(file->st.st_size), entries);
+    }
+    catch (Exception &ex) {
+	output.error("can't process '%s': %s", file->filepath.c_str(), ex.what());
+    }
+}
+
+
+void DatRepository::ScannedFile::read_prefixes() {
+    auto zip_archive = zip_open(filepath.c_str(), ZIP_RDONLY, nullptr);
+
+    if (zip_archive != nullptr) {
+	is_zip = true;
+	for (zip_uint64_t index = 0; static_cast<int64_t>(index) < zip_get_num_entries(zip_archive, 0); index++) {
+	    zip_stat_t zst;
+	    zip_file_t *zf;
+
+	    if (zip_stat_index(zip_archive, index, 0, &zst) < 0 || (zf = zip_fopen_index(zip_archive, index, 0)) == nullptr) {
+		continue;
+	    }
+
+	    auto &entry = entries.emplace_back();
+	    entry.name = zst.name;
+	    entry.mtime = zst.mtime;
+	    entry.prefix.resize(HEADER_PREFIX_SIZE);
+
+	    size_t length = 0;
+	    zip_int64_t n = 0;
+	    while (length < HEADER_PREFIX_SIZE && (n = zip_fread(zf, entry.prefix.data() + length, HEADER_PREFIX_SIZE - length)) > 0) {
+		length += static_cast<size_t>(n);
+	    }
+	    entry.prefix.resize(length);
+	    entry.complete = (n == 0);
+	    zip_fclose(zf);
+	}
+	zip_discard(zip_archive);
+    }
+    else {
+	// If the file can't be read, the parser source reports the error when trying to read it.
+	auto &entry = entries.emplace_back();
+	entry.mtime = st.st_mtime;
+
+	auto f = make_shared_file(filepath, "r");
+	if (f) {
+	    entry.prefix.resize(HEADER_PREFIX_SIZE);
+	    entry.prefix.resize(fread(entry.prefix.data(), 1, HEADER_PREFIX_SIZE, f.get()));
+	    entry.complete = feof(f.get()) != 0;
+	}
+    }
 }
 
 
@@ -36,10 +36,14 @@ IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "DatDb.h"
 
+#include <filesystem>
+#include <future>
 #include <optional>
 #include <string>
 #include <vector>
 
+#include <sys/stat.h>
+
 class DatRepository {
   public:
     explicit DatRepository(const std::vector<std::string> &directories);
@@ -51,8 +55,30 @@ class DatRepository {
     std::vector<std::string> list_dats();
 
   private:
+    // Beginning of a dat file, read in a worker thread so only the header parsing happens in the main thread.
+    class ScannedEntry {
+      public:
+        std::string name; // empty if not in zip archive
+        time_t mtime = 0;
+        std::vector<uint8_t> prefix;
+        bool complete = false; // prefix holds whole file
+    };
+
+    class ScannedFile {
+      public:
+        std::string file;
+        std::filesystem::path filepath;
+        struct stat st{};
+        bool is_zip = false;
+        std::vector<ScannedEntry> entries;
+        std::future<void> done;
+
+        void read_prefixes();
+    };
+
     std::unordered_map<std::string, DatDBPtr> dbs;
 
+    static void insert_file(const DatDBPtr &db, ScannedFile *file);
     static void update_directory(const std::string &directory, const DatDBPtr& db);
 };
 
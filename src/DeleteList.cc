@@ -80,7 +80,7 @@ void DeleteList::add_directory(const std::string &directory, bool omit_known) {
     bool have_toplevel_disks = false;
 
     try {
-        Dir dir(directory, false);
+        Dir dir(directory, false, ckmame_cache ? ckmame_cache->directory_snapshot.get() : nullptr);
         std::filesystem::path filepath;
         
         while ((filepath = dir.next()) != "") {
@@ -238,7 +238,7 @@ void DeleteList::sort_entries() {
 
 void DeleteList::list_non_chds(const std::string &directory) {
     try {
-        Dir dir(directory, true);
+        Dir dir(directory, true, ckmame_cache ? ckmame_cache->directory_snapshot.get() : nullptr);
         std::filesystem::path filepath;
         
         while ((filepath = dir.next()) != "") {
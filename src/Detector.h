@@ -70,6 +70,25 @@ public:
         TEST_FILE_GR
     };
     
+    // The beginning and end of a file, as far as the tests look at them.
+    class Sample {
+    public:
+        Sample(uint64_t size, uint64_t head_size, uint64_t tail_size);
+
+        uint64_t size;
+
+        // Keeps the parts of data at offset that fall into head or tail.
+        void add(uint64_t offset, const uint8_t *data, uint64_t length);
+        // Returns nullptr if the bytes are not in the sample.
+        [[nodiscard]] const uint8_t *get(uint64_t offset, uint64_t length) const;
+        [[nodiscard]] uint64_t get_head_size() const { return head.size(); }
+
+    private:
+        std::vector<uint8_t> head;
+        uint64_t tail_offset;
+        std::vector<uint8_t> tail;
+    };
+
     class Test {
     public:
         Test() : type(TEST_DATA), offset(0), length(0), result(true) { }
@@ -81,7 +100,9 @@ public:
         std::vector<uint8_t> value;
         bool result;
 
-        [[nodiscard]] bool execute(const std::vector<uint8_t> &data) const;
+        [[nodiscard]] bool execute(const Sample &sample) const;
+        [[nodiscard]] bool needs_tail() const;
+        void update_sample_sizes(uint64_t *head_size, uint64_t *tail_size) const;
         void print(FILE *fout) const;
         
     private:
@@ -97,11 +118,12 @@ public:
         Operation operation;
         std::vector<Test> tests;
         
-        [[nodiscard]] Hashes execute(const std::vector<uint8_t> &data) const;
+        // Returns false if the rule doesn't apply to files of this size.
+        bool get_range(uint64_t size, uint64_t *start, uint64_t *length) const;
+        // Tests that need the end of the file are skipped unless have_tail is true.
+        [[nodiscard]] bool matches(const Sample &sample, bool have_tail) const;
+        [[nodiscard]] bool needs_tail() const;
         void print(FILE *fout) const;
-        
-    private:
-        [[nodiscard]] Hashes compute_values(Operation operation, const std::vector<uint8_t> &data, uint64_t start, uint64_t length) const;
     };
     
 
@@ -117,8 +139,8 @@ public:
     static DetectorPtr parse(const std::string &filename);
     static DetectorPtr parse(ParserSource *parser_source);
 
-    [[nodiscard]] Hashes execute(const std::vector<uint8_t> &data) const;
     bool print(FILE *) const;
+    void update_sample_sizes(uint64_t *head_size, uint64_t *tail_size) const;
 
     static std::string file_test_type_name(TestType type);
     static std::string operation_name(Operation operation);
@@ -127,11 +149,14 @@ public:
     static size_t get_id(const DetectorDescriptor &descriptor) { return detector_ids.get_id(descriptor); }
     static const DetectorDescriptor *get_descriptor(size_t id) { return detector_ids.get_descriptor(id); }
     
-    // Returns true if new hashes were computed.
-    static bool compute_hashes(const std::vector<uint8_t> &data, File *file, const std::unordered_map<size_t, DetectorPtr> &detectors);
+    // Reads source once, without keeping the whole file in memory. Returns true if new hashes were computed.
+    static bool compute_hashes(const ZipSource *source, File *file, const std::unordered_map<size_t, DetectorPtr> &detectors);
 
 private:
+    class RuleHasher;
+
     static uint64_t operation_unit_size(Operation operation);
+    static void apply_operation(Operation operation, uint8_t *out, const uint8_t *in, size_t length);
     static DetectorCollection detector_ids;
 };
 
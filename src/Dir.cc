@@ -36,8 +36,13 @@
 #include <algorithm>
 #include <filesystem>
 
-Dir::Dir(const std::string &name, bool recursive) : index(0) {
-    if (recursive) {
+#include "DirectorySnapshot.h"
+
+Dir::Dir(const std::string &name, bool recursive, DirectorySnapshot *snapshot) : index(0) {
+    if (snapshot) {
+        snapshot->list(name, recursive, &entries);
+    }
+    else if (recursive) {
 	for (const auto &p : std::filesystem::recursive_directory_iterator(name)) {
 	    entries.push_back(p);
 	}
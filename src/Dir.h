@@ -38,9 +38,11 @@
 #include <string>
 #include <vector>
 
+class DirectorySnapshot;
+
 class Dir {
  public:
-    Dir(const std::string& path, bool recursive);
+    Dir(const std::string& path, bool recursive, DirectorySnapshot *snapshot = nullptr);
 
     std::filesystem::path next();
 
@@ -0,0 +1,254 @@
+/*
+DirectorySnapshot.cc -- persistent listing of directory trees
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "DirectorySnapshot.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/stat.h>
+
+#include "Exception.h"
+#include "globals.h"
+#include "util.h"
+
+#define DIRECTORY_SNAPSHOT_MAGIC "CKMDIRS"
+#define DIRECTORY_SNAPSHOT_VERSION 1
+
+namespace {
+bool read_value(FILE *fp, void *value, size_t size) {
+    return std::fread(value, size, 1, fp) == 1;
+}
+
+bool read_string(FILE *fp, std::string *string) {
+    uint32_t length;
+    if (!read_value(fp, &length, sizeof(length))) {
+        return false;
+    }
+    string->resize(length);
+    return length == 0 || std::fread(string->data(), 1, length, fp) == length;
+}
+
+bool write_value(FILE *fp, const void *value, size_t size) {
+    return std::fwrite(value, size, 1, fp) == 1;
+}
+
+bool write_string(FILE *fp, const std::string &string) {
+    auto length = static_cast<uint32_t>(string.size());
+    return write_value(fp, &length, sizeof(length)) && (length == 0 || std::fwrite(string.data(), 1, length, fp) == length);
+}
+}
+
+
+DirectorySnapshot::DirectorySnapshot(std::string file_name_) : file_name(std::move(file_name_)), loaded(false), changed(false), now(time(nullptr)) {
+}
+
+
+std::string DirectorySnapshot::default_file_name() {
+    auto directory = home_directory() / ".cache" / "ckmame";
+    ensure_directory(directory);
+    return directory / "directory-snapshot";
+}
+
+
+void DirectorySnapshot::list(const std::filesystem::path &directory, bool recursive, std::vector<std::filesystem::path> *entries) {
+    if (!loaded) {
+        load();
+    }
+    scan(directory, recursive, entries);
+}
+
+
+bool DirectorySnapshot::write() {
+    if (!changed) {
+        return true;
+    }
+
+    auto temp_name = file_name + ".tmp";
+    auto fp = std::fopen(temp_name.c_str(), "wb");
+    if (fp == nullptr) {
+        output.error_system("can't create directory snapshot '%s'", temp_name.c_str());
+        return false;
+    }
+
+    uint32_t version = DIRECTORY_SNAPSHOT_VERSION;
+    auto ok = write_value(fp, DIRECTORY_SNAPSHOT_MAGIC, sizeof(DIRECTORY_SNAPSHOT_MAGIC)) && write_value(fp, &version, sizeof(version));
+    for (const auto &pair : directories) {
+        if (!ok) {
+            break;
+        }
+        const auto &entry = pair.second;
+        auto mtime = static_cast<int64_t>(entry.mtime);
+        auto ctime = static_cast<int64_t>(entry.ctime);
+        auto count = static_cast<uint32_t>(entry.children.size());
+        ok = write_string(fp, pair.first) && write_value(fp, &mtime, sizeof(mtime)) && write_value(fp, &ctime, sizeof(ctime)) && write_value(fp, &entry.device, sizeof(entry.device)) && write_value(fp, &entry.inode, sizeof(entry.inode)) && write_value(fp, &count, sizeof(count));
+        for (const auto &child : entry.children) {
+            if (!ok) {
+                break;
+            }
+            uint8_t is_directory = child.is_directory ? 1 : 0;
+            ok = write_value(fp, &is_directory, sizeof(is_directory)) && write_string(fp, child.name);
+        }
+    }
+    if (std::fclose(fp) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        output.error_system("can't write directory snapshot '%s'", temp_name.c_str());
+        std::remove(temp_name.c_str());
+        return false;
+    }
+
+    if (std::rename(temp_name.c_str(), file_name.c_str()) != 0) {
+        output.error_system("can't rename '%s' to '%s'", temp_name.c_str(), file_name.c_str());
+        std::remove(temp_name.c_str());
+        return false;
+    }
+
+    changed = false;
+    return true;
+}
+
+
+void DirectorySnapshot::load() {
+    loaded = true;
+
+    auto fp = std::fopen(file_name.c_str(), "rb");
+    if (fp == nullptr) {
+        return;
+    }
+
+    char magic[sizeof(DIRECTORY_SNAPSHOT_MAGIC)];
+    uint32_t version;
+    auto ok = read_value(fp, magic, sizeof(magic)) && memcmp(magic, DIRECTORY_SNAPSHOT_MAGIC, sizeof(magic)) == 0 && read_value(fp, &version, sizeof(version)) && version == DIRECTORY_SNAPSHOT_VERSION;
+
+    while (ok) {
+        std::string name;
+        if (!read_string(fp, &name)) {
+            ok = feof(fp) && !ferror(fp);
+            break;
+        }
+
+        Entry entry;
+        int64_t mtime, ctime;
+        uint32_t count;
+        ok = read_value(fp, &mtime, sizeof(mtime)) && read_value(fp, &ctime, sizeof(ctime)) && read_value(fp, &entry.device, sizeof(entry.device)) && read_value(fp, &entry.inode, sizeof(entry.inode)) && read_value(fp, &count, sizeof(count));
+        entry.mtime = static_cast<time_t>(mtime);
+        entry.ctime = static_cast<time_t>(ctime);
+        for (uint32_t i = 0; ok && i < count; i++) {
+            uint8_t is_directory;
+            std::string child;
+            ok = read_value(fp, &is_directory, sizeof(is_directory)) && read_string(fp, &child);
+            entry.children.emplace_back(child, is_directory != 0);
+        }
+        if (ok) {
+            directories[name] = std::move(entry);
+        }
+    }
+
+    std::fclose(fp);
+
+    if (!ok) {
+        // Damaged, start over.
+        directories.clear();
+        changed = true;
+    }
+}
+
+
+void DirectorySnapshot::remove_tree(const std::string &directory) {
+    auto prefix = directory + "/";
+
+    directories.erase(directory);
+    auto it = directories.lower_bound(prefix);
+    while (it != directories.end() && it->first.compare(0, prefix.size(), prefix) == 0) {
+        it = directories.erase(it);
+    }
+}
+
+
+void DirectorySnapshot::scan(const std::filesystem::path &directory, bool recursive, std::vector<std::filesystem::path> *entries) {
+    struct stat st{};
+
+    if (stat(directory.c_str(), &st) < 0) {
+        auto error = std::string(strerror(errno));
+        remove_tree(directory);
+        changed = true;
+        throw Exception("can't stat '%s': %s", directory.c_str(), error.c_str());
+    }
+
+    auto &entry = directories[directory];
+
+    if (entry.mtime != st.st_mtime || entry.ctime != st.st_ctime || entry.device != static_cast<uint64_t>(st.st_dev) || entry.inode != static_cast<uint64_t>(st.st_ino)) {
+        std::vector<Child> children;
+
+        for (const auto &directory_entry : std::filesystem::directory_iterator(directory)) {
+            // Like recursive_directory_iterator, don't follow symbolic links to directories.
+            children.emplace_back(directory_entry.path().filename(), !directory_entry.is_symlink() && directory_entry.is_directory());
+        }
+        std::sort(children.begin(), children.end(), [](const Child &a, const Child &b) { return a.name < b.name; });
+
+        for (const auto &child : entry.children) {
+            if (child.is_directory) {
+                auto it = std::lower_bound(children.begin(), children.end(), child.name, [](const Child &a, const std::string &name) { return a.name < name; });
+                if (it == children.end() || it->name != child.name || !it->is_directory) {
+                    remove_tree(directory / child.name);
+                }
+            }
+        }
+
+        // remove_tree doesn't touch entry, only entries below it.
+        if (st.st_mtime < now && st.st_ctime < now) {
+            entry.mtime = st.st_mtime;
+            entry.ctime = st.st_ctime;
+        }
+        else {
+            // Changes later in the same second would go unnoticed, so read it again next time.
+            entry.mtime = -1;
+            entry.ctime = -1;
+        }
+        entry.device = static_cast<uint64_t>(st.st_dev);
+        entry.inode = static_cast<uint64_t>(st.st_ino);
+        entry.children = std::move(children);
+        changed = true;
+    }
+
+    for (const auto &child : entry.children) {
+        auto path = directory / child.name;
+        entries->push_back(path);
+        if (recursive && child.is_directory) {
+            scan(path, true, entries);
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef HAD_DIRECTORY_SNAPSHOT_H
+#define HAD_DIRECTORY_SNAPSHOT_H
+
+/*
+DirectorySnapshot.h -- persistent listing of directory trees
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <ctime>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+// Listings of scanned directories, kept in one file across runs.
+// A directory whose modification time, change time and inode are unchanged has the same entries, so it doesn't have to be read again.
+class DirectorySnapshot {
+public:
+    explicit DirectorySnapshot(std::string file_name);
+
+    static std::string default_file_name();
+
+    void list(const std::filesystem::path &directory, bool recursive, std::vector<std::filesystem::path> *entries);
+    bool write();
+
+private:
+    class Child {
+    public:
+        Child(std::string name_, bool is_directory_) : name(std::move(name_)), is_directory(is_directory_) { }
+
+        std::string name;
+        bool is_directory;
+    };
+
+    class Entry {
+    public:
+        Entry() : mtime(-1), ctime(-1), device(0), inode(0) { }
+
+        time_t mtime;
+        time_t ctime;
+        uint64_t device;
+        uint64_t inode;
+        std::vector<Child> children;
+    };
+
+    std::string file_name;
+    bool loaded;
+    bool changed;
+    time_t now;
+
+    std::map<std::string, Entry> directories;
+
+    void load();
+    void remove_tree(const std::string &directory);
+    void scan(const std::filesystem::path &directory, bool recursive, std::vector<std::filesystem::path> *entries);
+};
+
+#endif // HAD_DIRECTORY_SNAPSHOT_H
@@ -0,0 +1,209 @@
+/*
+HashPipeline.cc -- compute hashes in parallel pipeline stages
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "HashPipeline.h"
+
+#include <atomic>
+
+#include "MappedFile.h"
+
+const size_t HashPipeline::DEFAULT_BUFFER_SIZE = 1024 * 1024;
+const size_t HashPipeline::DEFAULT_BUFFER_COUNT = 4;
+// Below this, starting threads costs more than it gains.
+const uint64_t HashPipeline::MINIMUM_LENGTH = 4 * 1024 * 1024;
+
+
+HashPipeline::HashPipeline(Hashes *hashes_, size_t buffer_size, size_t buffer_count) : hashes(hashes_), buffer_size_(buffer_size), buffers(buffer_count), lengths(buffer_count), pending(buffer_count), produced(0), finished(false) {
+    for (auto &buffer : buffers) {
+        buffer.resize(buffer_size);
+    }
+
+    for (auto type = 1; type <= Hashes::TYPE_MAX; type <<= 1) {
+        if (hashes->has_type(type)) {
+            stages.push_back(std::make_unique<Stage>(type));
+        }
+    }
+    for (auto &stage : stages) {
+        auto stage_pointer = stage.get();
+        stage->thread = std::thread([this, stage_pointer]() { run(stage_pointer); });
+    }
+}
+
+
+HashPipeline::~HashPipeline() {
+    finish();
+}
+
+
+bool HashPipeline::is_worthwhile(const Hashes *hashes, uint64_t length) {
+    auto stages = 0;
+    for (auto type = 1; type <= Hashes::TYPE_MAX; type <<= 1) {
+        if (hashes->has_type(type)) {
+            stages += 1;
+        }
+    }
+
+    return stages > 1 && length >= MINIMUM_LENGTH && std::thread::hardware_concurrency() > 1;
+}
+
+
+unsigned char *HashPipeline::get_buffer() {
+    auto slot = produced % buffers.size();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    buffer_consumed.wait(lock, [this, slot]() { return pending[slot] == 0; });
+
+    return buffers[slot].data();
+}
+
+
+void HashPipeline::commit(size_t length) {
+    auto slot = produced % buffers.size();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        lengths[slot] = length;
+        pending[slot] = stages.size();
+        produced += 1;
+    }
+    buffer_produced.notify_all();
+}
+
+
+bool HashPipeline::compute(Hashes *hashes, const unsigned char *data, uint64_t length) {
+    std::vector<std::unique_ptr<Stage>> stages;
+
+    for (auto type = 1; type <= Hashes::TYPE_MAX; type <<= 1) {
+        if (hashes->has_type(type)) {
+            stages.push_back(std::make_unique<Stage>(type));
+        }
+    }
+
+    std::atomic<bool> ok(true);
+    auto hash = [data, length, &ok](Stage *stage) {
+        Hashes::Update hu(&stage->hashes);
+        if (!MappedFile::guard([&hu, data, length]() { hu.update(data, length); })) {
+            ok = false;
+        }
+        hu.end();
+    };
+
+    // The first type is computed in this thread.
+    for (size_t i = 1; i < stages.size(); i++) {
+        auto stage_pointer = stages[i].get();
+        stages[i]->thread = std::thread([hash, stage_pointer]() { hash(stage_pointer); });
+    }
+    if (!stages.empty()) {
+        hash(stages[0].get());
+    }
+    for (auto &stage : stages) {
+        if (stage->thread.joinable()) {
+            stage->thread.join();
+        }
+        store_result(hashes, stage->hashes);
+    }
+
+    return ok;
+}
+
+
+void HashPipeline::end() {
+    finish();
+
+    for (auto &stage : stages) {
+        store_result(hashes, stage->hashes);
+    }
+}
+
+
+void HashPipeline::store_result(Hashes *hashes, const Hashes &result) {
+    switch (result.get_types()) {
+        case Hashes::TYPE_CRC:
+            hashes->crc = result.crc;
+            break;
+
+        case Hashes::TYPE_MD5:
+            hashes->md5 = result.md5;
+            break;
+
+        case Hashes::TYPE_SHA1:
+            hashes->sha1 = result.sha1;
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+void HashPipeline::finish() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (finished) {
+            return;
+        }
+        finished = true;
+    }
+    buffer_produced.notify_all();
+
+    for (auto &stage : stages) {
+        stage->thread.join();
+    }
+}
+
+
+void HashPipeline::run(Stage *stage) {
+    Hashes::Update hu(&stage->hashes);
+
+    for (uint64_t index = 0;; index++) {
+        auto slot = index % buffers.size();
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            buffer_produced.wait(lock, [this, index]() { return finished || produced > index; });
+            if (produced <= index) {
+                break;
+            }
+        }
+
+        hu.update(buffers[slot].data(), lengths[slot]);
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            pending[slot] -= 1;
+        }
+        buffer_consumed.notify_one();
+    }
+
+    hu.end();
+}
@@ -0,0 +1,98 @@
+#ifndef HAD_HASH_PIPELINE_H
+#define HAD_HASH_PIPELINE_H
+
+/*
+HashPipeline.h -- compute hashes in parallel pipeline stages
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Hashes.h"
+
+// Computes each hash type in its own thread, while the caller fills the next buffer (e.g. by decompressing).
+class HashPipeline {
+public:
+    explicit HashPipeline(Hashes *hashes, size_t buffer_size = DEFAULT_BUFFER_SIZE, size_t buffer_count = DEFAULT_BUFFER_COUNT);
+    ~HashPipeline();
+
+    static bool is_worthwhile(const Hashes *hashes, uint64_t length);
+    // Compute hashes of data already in memory, each type in its own thread, without copying.
+    // data may be a file mapping; returns false if the file was truncated while reading it.
+    static bool compute(Hashes *hashes, const unsigned char *data, uint64_t length);
+
+    [[nodiscard]] size_t buffer_size() const { return buffer_size_; }
+    // Get buffer to fill, blocks until all stages are done with it.
+    unsigned char *get_buffer();
+    // Pass filled buffer to all stages.
+    void commit(size_t length);
+    // Wait for all stages to finish and store results in hashes.
+    void end();
+
+private:
+    static const size_t DEFAULT_BUFFER_SIZE;
+    static const size_t DEFAULT_BUFFER_COUNT;
+    static const uint64_t MINIMUM_LENGTH;
+
+    class Stage {
+    public:
+        explicit Stage(int type) { hashes.add_types(type); }
+
+        Hashes hashes;
+        std::thread thread;
+    };
+
+    Hashes *hashes;
+    size_t buffer_size_;
+    std::vector<std::vector<unsigned char>> buffers;
+    std::vector<size_t> lengths;
+    std::vector<size_t> pending; // number of stages still using buffer
+    uint64_t produced;
+    bool finished;
+
+    std::mutex mutex;
+    std::condition_variable buffer_produced;
+    std::condition_variable buffer_consumed;
+
+    std::vector<std::unique_ptr<Stage>> stages;
+
+    static void store_result(Hashes *hashes, const Hashes &result);
+
+    void finish();
+    void run(Stage *stage);
+};
+
+#endif // HAD_HASH_PIPELINE_H
@@ -0,0 +1,96 @@
+/*
+HashesBatch.cc -- compute hashes of several files at once
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "HashesBatch.h"
+
+#include <algorithm>
+
+#include "hashes_accelerated.h"
+
+// Files larger than this gain nothing from being batched and would need too much memory.
+const uint64_t HashesBatch::MAX_FILE_SIZE = 512 * 1024;
+const uint64_t HashesBatch::MAX_BATCH_SIZE = 8 * 1024 * 1024;
+
+
+HashesBatch::HashesBatch() : lanes(HashesAccelerated::md5_lanes()), size(0) {
+}
+
+
+void HashesBatch::add(Hashes *hashes, std::vector<uint8_t> data) {
+    size += data.size();
+    jobs.emplace_back(hashes, std::move(data));
+}
+
+
+bool HashesBatch::full() const {
+    return size >= MAX_BATCH_SIZE || jobs.size() >= 2 * std::max(lanes, static_cast<size_t>(1));
+}
+
+
+void HashesBatch::compute() {
+    std::vector<HashesAccelerated::Md5Job> md5_jobs;
+    auto batch_md5 = lanes > 1 && jobs.size() > 1;
+
+    for (auto &job : jobs) {
+        Hashes hashes;
+        auto types = job.hashes->get_types();
+
+        if (batch_md5 && (types & Hashes::TYPE_MD5)) {
+            md5_jobs.emplace_back(job.data.data(), job.data.size(), job.hashes->md5.data());
+            types &= ~Hashes::TYPE_MD5;
+        }
+
+        if (types != 0) {
+            hashes.add_types(types);
+            Hashes::Update hu(&hashes);
+            hu.update(job.data.data(), job.data.size());
+            hu.end();
+            if (types & Hashes::TYPE_CRC) {
+                job.hashes->crc = hashes.crc;
+            }
+            if (types & Hashes::TYPE_MD5) {
+                job.hashes->md5 = hashes.md5;
+            }
+            if (types & Hashes::TYPE_SHA1) {
+                job.hashes->sha1 = hashes.sha1;
+            }
+        }
+    }
+
+    if (!md5_jobs.empty()) {
+        HashesAccelerated::md5_multi(md5_jobs);
+    }
+
+    jobs.clear();
+    size = 0;
+}
@@ -0,0 +1,73 @@
+#ifndef HAD_HASHES_BATCH_H
+#define HAD_HASHES_BATCH_H
+
+/*
+HashesBatch.h -- compute hashes of several files at once
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Hashes.h"
+
+// Computes hashes of several small files at once, the MD5s interleaved in SIMD lanes.
+class HashesBatch {
+public:
+    static const uint64_t MAX_FILE_SIZE;
+
+    HashesBatch();
+
+    // Add file contents to batch. hashes must have the requested types set; results are stored there by compute().
+    void add(Hashes *hashes, std::vector<uint8_t> data);
+    void compute();
+
+    [[nodiscard]] bool empty() const { return jobs.empty(); }
+    [[nodiscard]] bool full() const;
+
+private:
+    static const uint64_t MAX_BATCH_SIZE;
+
+    class Job {
+    public:
+        Job(Hashes *hashes_, std::vector<uint8_t> data_) : hashes(hashes_), data(std::move(data_)) { }
+
+        Hashes *hashes;
+        std::vector<uint8_t> data;
+    };
+
+    std::vector<Job> jobs;
+    size_t lanes;
+    uint64_t size;
+};
+
+#endif // HAD_HASHES_BATCH_H
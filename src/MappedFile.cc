@@ -0,0 +1,135 @@
+/*
+MappedFile.cc -- read-only memory mapping of a file
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MappedFile.h"
+
+#include "config.h"
+
+#ifdef HAVE_MMAP
+#include <csetjmp>
+#include <csignal>
+#include <mutex>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const uint64_t MappedFile::MINIMUM_SIZE = 64 * 1024;
+
+#ifdef HAVE_MMAP
+namespace {
+thread_local sigjmp_buf *guard_jump = nullptr;
+std::once_flag sigbus_handler_installed;
+struct sigaction previous_sigbus_action;
+
+void sigbus_handler(int, siginfo_t *, void *) {
+    if (guard_jump != nullptr) {
+        siglongjmp(*guard_jump, 1);
+    }
+    // Not in a guarded read: the faulting access is repeated with the previous handler.
+    sigaction(SIGBUS, &previous_sigbus_action, nullptr);
+}
+
+void install_sigbus_handler() {
+    struct sigaction action{};
+    action.sa_sigaction = sigbus_handler;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGBUS, &action, &previous_sigbus_action);
+}
+} // namespace
+#endif
+
+
+MappedFile::~MappedFile() {
+#ifdef HAVE_MMAP
+    munmap(data_, static_cast<size_t>(size_));
+#endif
+}
+
+
+std::unique_ptr<MappedFile> MappedFile::open(const std::string &file_name) {
+#ifdef HAVE_MMAP
+    auto fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 || static_cast<uint64_t>(st.st_size) > SIZE_MAX) {
+        close(fd);
+        return nullptr;
+    }
+
+    auto size = static_cast<size_t>(st.st_size);
+    auto data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return nullptr;
+    }
+
+#ifdef MADV_SEQUENTIAL
+    madvise(data, size, MADV_SEQUENTIAL);
+#endif
+
+    return std::unique_ptr<MappedFile>(new MappedFile(data, size));
+#else
+    return nullptr;
+#endif
+}
+
+
+bool MappedFile::guard(const std::function<void()> &function) {
+#ifndef HAVE_MMAP
+    // Without mappings, there is nothing to be truncated.
+    function();
+    return true;
+#else
+    std::call_once(sigbus_handler_installed, install_sigbus_handler);
+
+    sigjmp_buf jump;
+    auto previous_jump = guard_jump;
+
+    if (sigsetjmp(jump, 1) != 0) {
+        guard_jump = previous_jump;
+        return false;
+    }
+    guard_jump = &jump;
+    function();
+    guard_jump = previous_jump;
+
+    return true;
+#endif
+}
@@ -0,0 +1,68 @@
+#ifndef HAD_MAPPED_FILE_H
+#define HAD_MAPPED_FILE_H
+
+/*
+MappedFile.h -- read-only memory mapping of a file
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+// Read-only memory mapping of a whole file, for hashing it without copying.
+class MappedFile {
+public:
+    ~MappedFile();
+
+    // Returns nullptr if the file can't be mapped; use regular reads then.
+    static std::unique_ptr<MappedFile> open(const std::string &file_name);
+    // Smaller files are faster to read than to map.
+    static bool is_worthwhile(uint64_t size) { return size >= MINIMUM_SIZE; }
+
+    // Runs function, which reads from a mapping. Returns false if the mapped file was truncated by another process while reading it, which would otherwise kill the program with SIGBUS.
+    // function is abandoned at the faulting read, so it must not allocate memory or take locks.
+    static bool guard(const std::function<void()> &function);
+
+    [[nodiscard]] const unsigned char *data() const { return static_cast<const unsigned char *>(data_); }
+    [[nodiscard]] uint64_t size() const { return size_; }
+
+private:
+    static const uint64_t MINIMUM_SIZE;
+
+    MappedFile(void *data, uint64_t size) : data_(data), size_(size) { }
+
+    void *data_;
+    uint64_t size_;
+};
+
+#endif // HAD_MAPPED_FILE_H
@@ -35,24 +35,13 @@
 */
 
 #include <memory>
-#include <optional>
 #include <vector>
 
 #include "Archive.h"
-#include "DB.h"
 
-class MemDB: public DB {
+// In-memory index of all files in known archives, used to find files by their hashes.
+class MemDB {
 public:
-    enum Statement {
-        DEC_FILE_IDX,
-        DELETE_FILE,
-        INSERT_FILE,
-        UPDATE_FILE
-    };
-    enum ParameterizedStatement {
-        QUERY_FILE
-    };
-
     class FindResult {
     public:
         uint64_t archive_id;
@@ -61,30 +50,19 @@ public:
         where_t location;
     };
     
-    explicit MemDB(const std::string &name) : DB(format, name, DBH_NEW) { }
-    ~MemDB() override = default;
+    virtual ~MemDB() = default;
     
-    static const DBFormat format;
-
     static void ensure();
 
-    void delete_file(const ArchiveContents *a, size_t idx, bool adjust_idx);
+    virtual void delete_file(const ArchiveContents *a, size_t idx, bool adjust_idx) = 0;
     void insert_archive(const ArchiveContents *archive);
-    void insert_file(const ArchiveContents *archive, size_t index);
+    virtual void insert_file(const ArchiveContents *archive, size_t index) = 0;
     void update_file(const ArchiveContents *archive, size_t idx);
 
-    std::vector<FindResult> find(filetype_t filetype, const FileData *file);
-
-protected:
-    std::string get_query(int name, bool parameterized) const override;
+    // Results are ordered by location, files with the same location in the order they were inserted.
+    virtual std::vector<FindResult> find(filetype_t filetype, const FileData *file) = 0;
 
 private:
-    DBStatement *get_statement(Statement name) { return get_statement_internal(name); }
-    DBStatement *get_statement(ParameterizedStatement name, const Hashes &hashes, bool have_size) { return get_statement_internal(name, hashes, have_size); }
-    
-    static std::unordered_map<Statement, std::string> queries;
-    static std::unordered_map<ParameterizedStatement, std::string> parameterized_queries;
-
     static bool inited;
 };
 
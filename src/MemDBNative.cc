@@ -0,0 +1,331 @@
+/*
+MemDBNative.cc -- in-memory file index in native hash tables
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "MemDBNative.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Exception.h"
+
+
+uint64_t MemDBNative::Key::hash() const {
+    // splitmix64 finalizer
+    auto value = size ^ (static_cast<uint64_t>(crc) << 16) ^ (static_cast<uint64_t>(filetype) << 56) ^ (static_cast<uint64_t>(flags) << 60);
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+
+uint32_t MemDBNative::Table::find(const Key &key) const {
+    if (slots.empty()) {
+        return NONE;
+    }
+
+    auto mask = slots.size() - 1;
+    for (auto i = key.hash() & mask; slots[i].in_use; i = (i + 1) & mask) {
+        if (slots[i].key == key) {
+            return slots[i].head;
+        }
+    }
+
+    return NONE;
+}
+
+
+uint32_t &MemDBNative::Table::get(const Key &key) {
+    // Slots are never removed, so the number of slots in use only grows with the number of distinct keys.
+    if ((used + 1) * 4 > slots.size() * 3) {
+        grow();
+    }
+
+    auto mask = slots.size() - 1;
+    auto i = key.hash() & mask;
+    for (; slots[i].in_use; i = (i + 1) & mask) {
+        if (slots[i].key == key) {
+            return slots[i].head;
+        }
+    }
+
+    slots[i].in_use = true;
+    slots[i].key = key;
+    used += 1;
+    return slots[i].head;
+}
+
+
+void MemDBNative::Table::grow() {
+    std::vector<Slot> old_slots(std::max(static_cast<size_t>(1024), slots.size() * 2));
+    old_slots.swap(slots);
+
+    auto mask = slots.size() - 1;
+    for (const auto &slot : old_slots) {
+        if (!slot.in_use) {
+            continue;
+        }
+        auto i = slot.key.hash() & mask;
+        while (slots[i].in_use) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = slot;
+    }
+}
+
+
+MemDBNative::Key MemDBNative::Entry::key(TableIndex table) const {
+    auto key_flags = static_cast<uint8_t>(flags & HAVE_SIZE);
+    uint32_t key_crc = 0;
+
+    if (table == BY_CRC && (flags & HAVE_CRC)) {
+        key_flags |= HAVE_CRC;
+        key_crc = crc;
+    }
+
+    return {filetype, key_flags, flags & HAVE_SIZE ? size : 0, key_crc};
+}
+
+
+// Same conditions as the query of the SQLite engine: hashes missing in the entry match any value.
+bool MemDBNative::Entry::matches(filetype_t filetype_, const FileData *file) const {
+    if (filetype != filetype_) {
+        return false;
+    }
+    if (file->is_size_known() && (!(flags & HAVE_SIZE) || size != file->hashes.size)) {
+        return false;
+    }
+    if (file->hashes.has_type(Hashes::TYPE_CRC) && (types & Hashes::TYPE_CRC) && crc != file->hashes.crc) {
+        return false;
+    }
+    if (file->hashes.has_type(Hashes::TYPE_MD5) && (types & Hashes::TYPE_MD5) && memcmp(md5, file->hashes.md5.data(), Hashes::SIZE_MD5) != 0) {
+        return false;
+    }
+    if (file->hashes.has_type(Hashes::TYPE_SHA1) && (types & Hashes::TYPE_SHA1) && memcmp(sha1, file->hashes.sha1.data(), Hashes::SIZE_SHA1) != 0) {
+        return false;
+    }
+    return true;
+}
+
+
+void MemDBNative::delete_file(const ArchiveContents *archive, size_t index, bool adjust_idx) {
+    auto it = archive_files.find(archive->id);
+    if (it == archive_files.end()) {
+        return;
+    }
+    auto &files = it->second;
+    if (index >= files.size()) {
+        return;
+    }
+
+    auto id = files[index];
+    while (id != NONE) {
+        auto next = entries[id].next_variant;
+        remove_entry(id);
+        id = next;
+    }
+
+    if (!adjust_idx) {
+        files[index] = NONE;
+        return;
+    }
+
+    files.erase(files.begin() + static_cast<std::vector<uint32_t>::difference_type>(index));
+    for (auto i = index; i < files.size(); i++) {
+        for (id = files[i]; id != NONE; id = entries[id].next_variant) {
+            entries[id].file_index = static_cast<uint32_t>(i);
+        }
+    }
+}
+
+
+void MemDBNative::insert_file(const ArchiveContents *archive, size_t index) {
+    auto &file = archive->files[index];
+
+    if (file.broken) {
+        return;
+    }
+
+    auto &files = archive_files[archive->id];
+    if (files.size() <= index) {
+        files.resize(index + 1, NONE);
+    }
+
+    auto id = add_entry(archive, index, 0, file.hashes);
+    entries[id].next_variant = files[index];
+    files[index] = id;
+
+    for (const auto &pair : file.detector_hashes) {
+        id = add_entry(archive, index, pair.first, pair.second);
+        entries[id].next_variant = files[index];
+        files[index] = id;
+    }
+}
+
+
+std::vector<MemDB::FindResult> MemDBNative::find(filetype_t filetype, const FileData *file) {
+    std::vector<uint32_t> ids;
+
+    if (file->is_size_known() && file->hashes.has_type(Hashes::TYPE_CRC)) {
+        auto type = static_cast<uint8_t>(filetype);
+        collect(tables[BY_CRC].find(Key(type, HAVE_SIZE | HAVE_CRC, file->hashes.size, file->hashes.crc)), BY_CRC, filetype, file, &ids);
+        collect(tables[BY_CRC].find(Key(type, HAVE_SIZE, file->hashes.size, 0)), BY_CRC, filetype, file, &ids);
+    }
+    else if (file->is_size_known()) {
+        collect(tables[BY_SIZE].find(Key(static_cast<uint8_t>(filetype), HAVE_SIZE, file->hashes.size, 0)), BY_SIZE, filetype, file, &ids);
+    }
+    else {
+        for (uint32_t id = 0; id < entries.size(); id++) {
+            if ((entries[id].flags & IN_USE) && entries[id].matches(filetype, file)) {
+                ids.push_back(id);
+            }
+        }
+    }
+
+    std::sort(ids.begin(), ids.end(), [this](uint32_t a, uint32_t b) {
+        if (entries[a].location != entries[b].location) {
+            return entries[a].location < entries[b].location;
+        }
+        return entries[a].sequence < entries[b].sequence;
+    });
+
+    std::vector<FindResult> results;
+    results.reserve(ids.size());
+    for (auto id : ids) {
+        const auto &entry = entries[id];
+        FindResult result;
+
+        result.archive_id = entry.archive_id;
+        result.index = entry.file_index;
+        result.detector_id = entry.detector_id;
+        result.location = static_cast<where_t>(entry.location);
+
+        results.push_back(result);
+    }
+
+    return results;
+}
+
+
+uint32_t MemDBNative::add_entry(const ArchiveContents *archive, size_t index, size_t detector_id, const Hashes &hashes) {
+    uint32_t id;
+
+    if (first_free != NONE) {
+        id = first_free;
+        first_free = entries[id].next_variant;
+    }
+    else {
+        if (entries.size() >= NONE) {
+            throw Exception("too many files in memdb");
+        }
+        id = static_cast<uint32_t>(entries.size());
+        entries.emplace_back();
+    }
+
+    auto &entry = entries[id];
+    entry = Entry();
+
+    entry.archive_id = archive->id;
+    entry.sequence = next_sequence++;
+    entry.file_index = static_cast<uint32_t>(index);
+    entry.detector_id = static_cast<uint32_t>(detector_id);
+    entry.filetype = static_cast<uint8_t>(archive->filetype);
+    entry.location = static_cast<int8_t>(archive->where);
+    entry.flags = IN_USE;
+    entry.next_variant = NONE;
+    entry.types = static_cast<uint8_t>(hashes.get_types());
+    if (hashes.has_size()) {
+        entry.flags |= HAVE_SIZE;
+        entry.size = hashes.size;
+    }
+    if (hashes.has_type(Hashes::TYPE_CRC)) {
+        entry.flags |= HAVE_CRC;
+        entry.crc = hashes.crc;
+    }
+    if (hashes.has_type(Hashes::TYPE_MD5)) {
+        memcpy(entry.md5, hashes.md5.data(), Hashes::SIZE_MD5);
+    }
+    if (hashes.has_type(Hashes::TYPE_SHA1)) {
+        memcpy(entry.sha1, hashes.sha1.data(), Hashes::SIZE_SHA1);
+    }
+
+    link(id, BY_CRC);
+    link(id, BY_SIZE);
+
+    return id;
+}
+
+
+void MemDBNative::remove_entry(uint32_t id) {
+    unlink(id, BY_CRC);
+    unlink(id, BY_SIZE);
+
+    entries[id].flags = 0;
+    entries[id].next_variant = first_free;
+    first_free = id;
+}
+
+
+void MemDBNative::link(uint32_t id, TableIndex table) {
+    auto &head = tables[table].get(entries[id].key(table));
+
+    entries[id].links[table].previous = NONE;
+    entries[id].links[table].next = head;
+    if (head != NONE) {
+        entries[head].links[table].previous = id;
+    }
+    head = id;
+}
+
+
+void MemDBNative::unlink(uint32_t id, TableIndex table) {
+    const auto &link = entries[id].links[table];
+
+    if (link.previous != NONE) {
+        entries[link.previous].links[table].next = link.next;
+    }
+    else {
+        tables[table].get(entries[id].key(table)) = link.next;
+    }
+    if (link.next != NONE) {
+        entries[link.next].links[table].previous = link.previous;
+    }
+}
+
+
+void MemDBNative::collect(uint32_t head, TableIndex table, filetype_t filetype, const FileData *file, std::vector<uint32_t> *result) const {
+    for (auto id = head; id != NONE; id = entries[id].links[table].next) {
+        if (entries[id].matches(filetype, file)) {
+            result->push_back(id);
+        }
+    }
+}
@@ -0,0 +1,146 @@
+#ifndef HAD_MEMDB_NATIVE_H
+#define HAD_MEMDB_NATIVE_H
+
+/*
+MemDBNative.h -- in-memory file index in native hash tables
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "MemDB.h"
+
+// Files are kept in one array of compact records, linked into buckets of two open addressing hash tables:
+// one keyed by (filetype, size, crc) for normal lookups, one keyed by (filetype, size) for files without crc.
+class MemDBNative : public MemDB {
+public:
+    MemDBNative() : next_sequence(0), first_free(NONE) { }
+    ~MemDBNative() override = default;
+
+    void delete_file(const ArchiveContents *a, size_t idx, bool adjust_idx) override;
+    void insert_file(const ArchiveContents *archive, size_t index) override;
+
+    std::vector<FindResult> find(filetype_t filetype, const FileData *file) override;
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    enum {
+        HAVE_SIZE = 1,
+        HAVE_CRC = 2,
+        IN_USE = 4
+    };
+
+    enum TableIndex {
+        BY_CRC,
+        BY_SIZE,
+        TABLE_COUNT
+    };
+
+    class Key {
+    public:
+        Key() : size(0), crc(0), filetype(0), flags(0) { }
+        Key(uint8_t filetype_, uint8_t flags_, uint64_t size_, uint32_t crc_) : size(size_), crc(crc_), filetype(filetype_), flags(flags_) { }
+
+        uint64_t size;
+        uint32_t crc;
+        uint8_t filetype;
+        uint8_t flags;
+
+        bool operator==(const Key &other) const { return size == other.size && crc == other.crc && filetype == other.filetype && flags == other.flags; }
+        [[nodiscard]] uint64_t hash() const;
+    };
+
+    class Link {
+    public:
+        uint32_t next;
+        uint32_t previous;
+    };
+
+    class Entry {
+    public:
+        uint64_t archive_id;
+        uint64_t sequence; // insertion order, used to order results like the SQLite engine
+        uint64_t size;
+        uint32_t file_index;
+        uint32_t detector_id;
+        uint32_t crc;
+        uint32_t next_variant; // next entry for same file (other detectors), or next free entry
+        Link links[TABLE_COUNT];
+        uint8_t filetype;
+        int8_t location;
+        uint8_t flags;
+        uint8_t types;
+        uint8_t md5[Hashes::SIZE_MD5];
+        uint8_t sha1[Hashes::SIZE_SHA1];
+
+        [[nodiscard]] Key key(TableIndex table) const;
+        [[nodiscard]] bool matches(filetype_t filetype, const FileData *file) const;
+    };
+
+    class Table {
+    public:
+        Table() : used(0) { }
+
+        [[nodiscard]] uint32_t find(const Key &key) const;
+        uint32_t &get(const Key &key);
+
+    private:
+        class Slot {
+        public:
+            Slot() : head(NONE), in_use(false) { }
+            Key key;
+            uint32_t head;
+            bool in_use;
+        };
+
+        std::vector<Slot> slots;
+        size_t used;
+
+        void grow();
+    };
+
+    std::vector<Entry> entries;
+    Table tables[TABLE_COUNT];
+    std::unordered_map<uint64_t, std::vector<uint32_t>> archive_files; // archive id -> first entry for each file index
+    uint64_t next_sequence;
+    uint32_t first_free;
+
+    uint32_t add_entry(const ArchiveContents *archive, size_t index, size_t detector_id, const Hashes &hashes);
+    void remove_entry(uint32_t id);
+    void link(uint32_t id, TableIndex table);
+    void unlink(uint32_t id, TableIndex table);
+    void collect(uint32_t head, TableIndex table, filetype_t filetype, const FileData *file, std::vector<uint32_t> *result) const;
+};
+
+#endif // HAD_MEMDB_NATIVE_H
@@ -34,10 +34,16 @@
 #include "OutputContextDb.h"
 
 #include <algorithm>
+#include <cstdarg>
 #include <filesystem>
 
 #include "file_util.h"
 #include "globals.h"
+#include "util.h"
+
+const size_t OutputContextDb::BATCH_SIZE = 256;
+const size_t OutputContextDb::GAMES_PER_TRANSACTION = 4096;
+const size_t OutputContextDb::MAX_PENDING_BATCHES = 4;
 
 
 struct fbh_context {
@@ -48,7 +54,11 @@ struct fbh_context {
 
 OutputContextDb::OutputContextDb(const std::string &dbname, int flags) :
 									 file_name(dbname),
-									 ok(true) {
+									 ok(true),
+									 messages(nullptr),
+									 games_in_transaction(0),
+									 games_written(0),
+									 start_time(std::chrono::steady_clock::now()) {
     temp_file_name = file_name + "-mkmamedb";
     if (configuration.use_temp_directory) {
 	auto tmpdir = getenv("TMPDIR");
@@ -59,6 +69,12 @@ OutputContextDb::OutputContextDb(const std::string &dbname, int flags) :
     temp_file_name = make_unique_name(temp_file_name, "");
 
     db = std::make_unique<RomDB>(temp_file_name, DBH_NEW);
+    // The database is renamed into place only after it is complete.
+    db->enable_bulk_load();
+
+    if (configuration.jobs > 1) {
+        writer = std::make_unique<ThreadPool>(1);
+    }
 }
 
 
@@ -67,6 +83,8 @@ OutputContextDb::~OutputContextDb() {
         close();
     }
     catch (...) { }
+    // finish batches still queued after an error before the members they use are destroyed
+    writer = nullptr;
 }
 
 
@@ -97,7 +115,7 @@ void OutputContextDb::familymeeting(Game *parent, Game *child) {
             }
              
             if (cr.where == FILE_INGAME && !cr.merge.empty()) {
-                output.file_error("In game '%s': '%s': merged from '%s', but ancestors don't contain matching file", child->name.c_str(), cr.name.c_str(), cr.merge.c_str());
+                error(true, "In game '%s': '%s': merged from '%s', but ancestors don't contain matching file", child->name.c_str(), cr.name.c_str(), cr.merge.c_str());
             }
         }
     }
@@ -161,6 +179,8 @@ bool OutputContextDb::lost(Game *game) {
 
 bool OutputContextDb::close() {
     if (db) {
+        write_pending_batches();
+
 	// TODO: don't write stuff if !ok
         db->write_dat(dat);
 
@@ -172,8 +192,18 @@ bool OutputContextDb::close() {
 
         db = nullptr;
 
+        if (configuration.verbose) {
+            auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+            output.message("%zu games written in %.1f seconds (%.0f games/s)", games_written, seconds, seconds > 0 ? static_cast<double>(games_written) / seconds : 0.0);
+        }
+
 	if (ok) { // TODO: and no previous errors
+	    std::error_code ec;
+	    std::filesystem::remove(RomDBSnapshot::file_name(file_name), ec); // would be out of date
 	    rename_or_move(temp_file_name, file_name);
+	    if (configuration.rom_db_snapshot) {
+		write_snapshot();
+	    }
 	}
 	else {
 	    std::filesystem::remove(temp_file_name);
@@ -184,7 +214,19 @@ bool OutputContextDb::close() {
 }
 
 
+void OutputContextDb::write_snapshot() {
+    try {
+        RomDB rom_db(file_name, DBH_READ);
+        RomDBSnapshot::write(&rom_db, file_name);
+    }
+    catch (std::exception &e) {
+        output.error("can't write snapshot of '%s': %s", file_name.c_str(), e.what());
+    }
+}
+
+
 bool OutputContextDb::detector(Detector *detector) {
+    write_pending_batches();
     db->write_detector(*detector);
 
     return true;
@@ -192,22 +234,47 @@ bool OutputContextDb::detector(Detector *detector) {
 
 
 bool OutputContextDb::game(GamePtr game, const std::string &original_name) {
+    if (!writer) {
+        add_game(std::move(game), original_name);
+        return true;
+    }
+
+    if (!batch) {
+        batch = std::make_shared<Batch>();
+    }
+    batch->games.emplace_back(std::move(game), original_name);
+
+    if (batch->games.size() >= BATCH_SIZE) {
+        while (pending_batches.size() >= MAX_PENDING_BATCHES) {
+            wait_for_batch();
+        }
+        submit_batch();
+    }
+
+    // report errors of finished batches while parsing continues
+    while (!pending_batches.empty() && pending_batches.front().second.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        wait_for_batch();
+    }
+
+    return true;
+}
+
+
+void OutputContextDb::add_game(GamePtr game, const std::string &original_name) {
     if (!original_name.empty()) {
         renamed_games[original_name] = game->name;
     }
-    auto g2 = db->read_game(game->name);
-
-    if (g2) {
+    if (game_names.find(game->name) != game_names.end()) {
 	std::string name;
 	size_t n = 1;
 	while (true) {
 	    name = game->name + " (" + std::to_string(n) + ")";
-	    if (db->read_game(name) == nullptr) {
+	    if (game_names.find(name) == game_names.end()) {
 		break;
 	    }
 	    n += 1;
 	}
-	output.error("warning: duplicate game '%s', renamed to '%s'", game->name.c_str(), name.c_str());
+	error(false, "warning: duplicate game '%s', renamed to '%s'", game->name.c_str(), name.c_str());
 	game->name = name;
     }
 
@@ -226,13 +293,100 @@ bool OutputContextDb::game(GamePtr game, const std::string &original_name) {
         }
     }
 
-    db->write_game(game.get());
+    if (!db->in_transaction()) {
+        db->begin_transaction();
+    }
+    db->insert_game(game.get());
+    game_names.insert(game->name);
+    games_written += 1;
+    games_in_transaction += 1;
+    if (games_in_transaction >= GAMES_PER_TRANSACTION) {
+        end_transaction();
+    }
+}
+
 
-    return true;
+void OutputContextDb::end_transaction() {
+    if (db->in_transaction()) {
+        db->commit_transaction();
+    }
+    games_in_transaction = 0;
+}
+
+
+void OutputContextDb::error(bool file_error, const char *fmt, ...) {
+    va_list va;
+    va_start(va, fmt);
+    auto text = string_format_v(fmt, va);
+    va_end(va);
+
+    if (messages != nullptr) {
+        messages->emplace_back(file_error, text);
+    }
+    else if (file_error) {
+        output.file_error("%s", text.c_str());
+    }
+    else {
+        output.error("%s", text.c_str());
+    }
+}
+
+
+void OutputContextDb::wait_for_batch() {
+    auto current_batch = std::move(pending_batches.front());
+    pending_batches.pop_front();
+
+    current_batch.second.wait();
+    for (const auto &message : current_batch.first->messages) {
+        if (message.file_error) {
+            output.file_error("%s", message.text.c_str());
+        }
+        else {
+            output.error("%s", message.text.c_str());
+        }
+    }
+    current_batch.second.get();
+}
+
+
+// Runs in writer thread.
+void OutputContextDb::write_batch(Batch *current_batch) {
+    messages = &current_batch->messages;
+    try {
+        for (auto &entry : current_batch->games) {
+            add_game(std::move(entry.first), entry.second);
+        }
+    }
+    catch (...) {
+        messages = nullptr;
+        throw;
+    }
+    messages = nullptr;
+}
+
+
+void OutputContextDb::submit_batch() {
+    auto current_batch = std::move(batch);
+    pending_batches.emplace_back(current_batch, writer->submit([this, current_batch]() { write_batch(current_batch.get()); }));
+}
+
+
+void OutputContextDb::write_pending_batches() {
+    if (writer) {
+        if (batch) {
+            submit_batch();
+        }
+        while (!pending_batches.empty()) {
+            wait_for_batch();
+        }
+    }
+
+    end_transaction();
 }
 
 
 bool OutputContextDb::header(DatEntry *entry) {
+    write_pending_batches();
     handle_lost(); // from previous dat
 
     dat.push_back(*entry);
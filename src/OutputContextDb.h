@@ -34,8 +34,15 @@
   IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <chrono>
+#include <deque>
+#include <future>
+#include <unordered_set>
+
 #include "OutputContext.h"
+#include "printf_like.h"
 #include "RomDB.h"
+#include "ThreadPool.h"
 
 
 class OutputContextDb : public OutputContext {
@@ -50,6 +57,27 @@ public:
     void error_occurred() override { ok = false; }
 
 private:
+    // Games are resolved against their parents and written in a separate thread, in batches of this many games.
+    static const size_t BATCH_SIZE;
+    // Games are inserted in transactions of this many games.
+    static const size_t GAMES_PER_TRANSACTION;
+    // Parsing blocks while this many batches are waiting to be written.
+    static const size_t MAX_PENDING_BATCHES;
+
+    class Message {
+    public:
+        Message(bool file_error_, std::string text_) : file_error(file_error_), text(std::move(text_)) { }
+        bool file_error;
+        std::string text;
+    };
+
+    class Batch {
+    public:
+        std::vector<std::pair<GamePtr, std::string>> games;
+        // Errors found while writing, printed by the main thread.
+        std::vector<Message> messages;
+    };
+
     std::string file_name;
     std::string temp_file_name;
 
@@ -60,11 +88,31 @@ private:
     std::vector<std::string> lost_children;
 
     bool ok;
-    
+
+    std::unique_ptr<ThreadPool> writer;
+    std::shared_ptr<Batch> batch;
+    std::deque<std::pair<std::shared_ptr<Batch>, std::future<void>>> pending_batches;
+    // Messages of the batch currently being written, nullptr if errors are printed directly.
+    std::vector<Message> *messages;
+
+    // Names of all games written, to detect duplicates without querying the database.
+    std::unordered_set<std::string> game_names;
+    size_t games_in_transaction;
+    size_t games_written;
+    std::chrono::steady_clock::time_point start_time;
+
+    void add_game(GamePtr game, const std::string &original_name);
+    void end_transaction();
+    void error(bool file_error, const char *fmt, ...) PRINTF_LIKE(3, 4);
     void familymeeting(Game *parent, Game *child);
     std::string get_game_name(const std::string& original_name);
     bool handle_lost();
     bool lost(Game *);
+    void submit_batch();
+    void wait_for_batch();
+    void write_batch(Batch *batch);
+    void write_pending_batches();
+    void write_snapshot();
 
     std::unordered_map<std::string, std::string> renamed_games;
 };
@@ -0,0 +1,127 @@
+/*
+ParserSourcePrefix.cc -- parser input data read ahead into memory
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ParserSourcePrefix.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <utility>
+
+#include "Exception.h"
+#include "ParserSourceFile.h"
+#include "ParserSourceZip.h"
+#include "globals.h"
+
+ParserSourcePrefix::ParserSourcePrefix(std::string archive_name_, std::string file_name_, time_t mtime_, std::vector<uint8_t> prefix_, bool complete_) : archive_name(std::move(archive_name_)), file_name(std::move(file_name_)), mtime(mtime_), prefix(std::move(prefix_)), offset(0), complete(complete_), za(nullptr) {
+    output.push_error_archive(archive_name, file_name);
+}
+
+ParserSourcePrefix::~ParserSourcePrefix() {
+    output.pop_error_file_info();
+    close();
+}
+
+bool ParserSourcePrefix::close() {
+    auto ok = true;
+
+    if (rest) {
+        ok = rest->close();
+        rest = nullptr;
+    }
+    if (za != nullptr) {
+        zip_discard(za);
+        za = nullptr;
+    }
+    prefix.clear();
+    offset = 0;
+
+    return ok;
+}
+
+
+ParserSourcePtr ParserSourcePrefix::open(const std::string &name) {
+    if (archive_name.empty()) {
+        return open_file(std::filesystem::path(file_name).parent_path() / name);
+    }
+    return open_file(file_name)->open(name);
+}
+
+
+size_t ParserSourcePrefix::read_xxx(void *data, size_t length) {
+    if (offset < prefix.size()) {
+        auto n = std::min(length, prefix.size() - offset);
+        memcpy(data, prefix.data() + offset, n);
+        offset += n;
+        return n;
+    }
+
+    if (complete) {
+        return 0;
+    }
+
+    if (!rest) {
+        rest = open_file(file_name);
+
+        uint8_t buffer[BUFSIZ];
+        auto skip = prefix.size();
+        while (skip > 0) {
+            auto n = rest->read_xxx(buffer, std::min(skip, sizeof(buffer)));
+            if (n == 0) {
+                return 0;
+            }
+            skip -= n;
+        }
+    }
+
+    return rest->read_xxx(data, length);
+}
+
+
+ParserSourcePtr ParserSourcePrefix::open_file(const std::string &name) {
+    if (archive_name.empty()) {
+        return std::make_shared<ParserSourceFile>(name);
+    }
+
+    if (za == nullptr) {
+        if ((za = zip_open(archive_name.c_str(), ZIP_RDONLY, nullptr)) == nullptr) {
+            throw Exception("can't open '%s'", archive_name.c_str());
+        }
+    }
+    try {
+        return std::make_shared<ParserSourceZip>(archive_name, za, name);
+    }
+    catch (std::exception &) {
+        throw Exception("can't open '%s' in '%s'", name.c_str(), archive_name.c_str());
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef HAD_PARSER_SOURCE_PREFIX_H
+#define HAD_PARSER_SOURCE_PREFIX_H
+
+/*
+ParserSourcePrefix.h -- parser input data read ahead into memory
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <vector>
+
+#include <zip.h>
+
+#include "ParserSource.h"
+
+// Serves the beginning of a file from memory and reads the rest from the file itself only if the parser gets that far.
+class ParserSourcePrefix : public ParserSource {
+public:
+    // archive_name is empty if file_name is not inside a zip archive. complete is true if prefix holds the whole file.
+    ParserSourcePrefix(std::string archive_name, std::string file_name, time_t mtime, std::vector<uint8_t> prefix, bool complete);
+    ~ParserSourcePrefix() override;
+
+    bool close() override;
+    ParserSourcePtr open(const std::string &name) override;
+    size_t read_xxx(void *data, size_t length) override;
+    time_t get_mtime() override { return mtime; }
+
+private:
+    std::string archive_name;
+    std::string file_name;
+    time_t mtime;
+    std::vector<uint8_t> prefix;
+    size_t offset;
+    bool complete;
+
+    struct zip *za;
+    ParserSourcePtr rest;
+
+    ParserSourcePtr open_file(const std::string &name);
+};
+
+#endif // HAD_PARSER_SOURCE_PREFIX_H
@@ -0,0 +1,287 @@
+/*
+PrecomputedHashes.cc -- hashes of ROM set files computed by worker threads
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "PrecomputedHashes.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#include <sys/stat.h>
+#include <zip.h>
+
+#include "Archive.h"
+#include "CkmameCache.h"
+#include "CkmameDB.h"
+#include "Exception.h"
+#include "globals.h"
+#include "RomDB.h"
+
+#define BUFSIZE (64 * 1024)
+
+PrecomputedHashesPtr precomputed_hashes;
+
+
+PrecomputedHashes::Batch PrecomputedHashes::compute(const std::vector<std::string> &archive_names) {
+    Batch batch;
+
+    for (const auto &name : archive_names) {
+        auto job = std::make_shared<Job>(name, configuration.roms_zipped, Hashes::TYPE_CRC | db->hashtypes(TYPE_ROM));
+
+        if (!prepare_job(job.get())) {
+            continue;
+        }
+
+        batch.push_back(pool.submit([this, job]() {
+            try {
+                if (job->zipped) {
+                    compute_zip(*job);
+                }
+                else {
+                    compute_dir(*job);
+                }
+            }
+            catch (...) {
+                // Files that could not be hashed here are hashed (and errors reported) when the archive is checked.
+            }
+        }));
+    }
+
+    return batch;
+}
+
+
+void PrecomputedHashes::forget(const std::vector<std::string> &archive_names) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    for (const auto &name : archive_names) {
+        entries.erase(name);
+    }
+}
+
+
+bool PrecomputedHashes::get(const std::string &archive_name, const File &file, Hashes *hashes) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    auto it = entries.find(archive_name);
+    if (it == entries.end()) {
+        return false;
+    }
+    auto it_file = it->second.find(file.name);
+    if (it_file == it->second.end()) {
+        return false;
+    }
+
+    auto entry = it_file->second;
+    it->second.erase(it_file);
+
+    if (entry.mtime != file.mtime || entry.hashes.size != file.hashes.size || (file.hashes.has_type(Hashes::TYPE_CRC) && entry.hashes.crc != file.hashes.crc)) {
+        return false;
+    }
+
+    *hashes = entry.hashes;
+    return true;
+}
+
+
+bool PrecomputedHashes::prepare_job(Job *job) {
+    if (ArchiveContents::by_name(TYPE_ROM, job->name)) {
+        // already open, hashes were computed (if needed) before
+        return false;
+    }
+
+    if (job->zipped) {
+        if (strcasecmp(std::filesystem::path(job->name).extension().c_str(), ".zip") != 0) {
+            return false;
+        }
+        if (job->hashtypes == Hashes::TYPE_CRC) {
+            // CRC is stored in zip archive
+            return false;
+        }
+    }
+    else {
+        // files without cached CRC are always hashed completely
+        job->hashtypes = Hashes::TYPE_ALL;
+    }
+
+    auto cache_db = ckmame_cache->get_db_for_archive(job->name);
+    if (cache_db) {
+        try {
+            // Leave the lookup and the preloaded files to opening the archive later.
+            auto id = cache_db->get_archive_id(job->name, TYPE_ROM, true);
+            if (id > 0) {
+                std::vector<File> files;
+                cache_db->read_files(id, &files, true);
+                for (const auto &file : files) {
+                    job->cached_files[file.name] = file;
+                }
+            }
+        }
+        catch (Exception &exception) {
+            job->cached_files.clear();
+        }
+    }
+
+    return true;
+}
+
+
+void PrecomputedHashes::add(const std::string &archive_name, const std::string &file_name, const Entry &entry) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    entries[archive_name][file_name] = entry;
+}
+
+
+void PrecomputedHashes::compute_dir(const Job &job) {
+    std::error_code ec;
+    auto buffer = std::make_unique<unsigned char[]>(BUFSIZE);
+
+    for (const auto &dir_entry : std::filesystem::recursive_directory_iterator(job.name, std::filesystem::directory_options::skip_permission_denied, ec)) {
+        if (!dir_entry.is_regular_file(ec)) {
+            continue;
+        }
+        auto file_name = dir_entry.path().string();
+        if (file_name.size() <= job.name.size() + 1) {
+            continue;
+        }
+        auto name_in_archive = file_name.substr(job.name.size() + 1);
+
+        struct stat st{};
+        if (stat(file_name.c_str(), &st) < 0) {
+            continue;
+        }
+        if (job.is_cached(name_in_archive, st.st_mtime, static_cast<uint64_t>(st.st_size))) {
+            continue;
+        }
+
+        auto fp = std::fopen(file_name.c_str(), "rb");
+        if (fp == nullptr) {
+            continue;
+        }
+
+        Entry entry;
+        entry.mtime = st.st_mtime;
+        entry.hashes.size = static_cast<uint64_t>(st.st_size);
+        entry.hashes.add_types(Hashes::TYPE_ALL);
+
+        uint64_t length = 0;
+        {
+            Hashes::Update hu(&entry.hashes);
+            size_t n;
+            while ((n = std::fread(buffer.get(), 1, BUFSIZE, fp)) > 0) {
+                hu.update(buffer.get(), n);
+                length += n;
+            }
+            hu.end();
+        }
+        auto ok = !std::ferror(fp);
+        std::fclose(fp);
+
+        // skip files that changed while we were reading them
+        struct stat st_after{};
+        if (!ok || length != entry.hashes.size || stat(file_name.c_str(), &st_after) < 0 || st_after.st_mtime != st.st_mtime || st_after.st_size != st.st_size) {
+            continue;
+        }
+
+        add(job.name, name_in_archive, entry);
+    }
+}
+
+
+void PrecomputedHashes::compute_zip(const Job &job) {
+    int error;
+    auto za = zip_open(job.name.c_str(), ZIP_RDONLY, &error);
+    if (za == nullptr) {
+        return;
+    }
+
+    auto buffer = std::make_unique<unsigned char[]>(BUFSIZE);
+    auto n = static_cast<zip_uint64_t>(zip_get_num_entries(za, 0));
+
+    for (zip_uint64_t index = 0; index < n; index++) {
+        struct zip_stat st;
+        if (zip_stat_index(za, index, 0, &st) < 0) {
+            continue;
+        }
+        if (job.is_cached(st.name, st.mtime, st.size)) {
+            continue;
+        }
+
+        auto zf = zip_fopen_index(za, index, 0);
+        if (zf == nullptr) {
+            continue;
+        }
+
+        Entry entry;
+        entry.mtime = st.mtime;
+        entry.hashes.size = st.size;
+        entry.hashes.add_types(Hashes::TYPE_ALL);
+
+        auto ok = true;
+        {
+            Hashes::Update hu(&entry.hashes);
+            auto length = st.size;
+            while (length > 0) {
+                auto m = zip_fread(zf, buffer.get(), std::min(length, static_cast<zip_uint64_t>(BUFSIZE)));
+                if (m <= 0) {
+                    ok = false;
+                    break;
+                }
+                hu.update(buffer.get(), static_cast<size_t>(m));
+                length -= static_cast<zip_uint64_t>(m);
+            }
+            hu.end();
+        }
+        // reading past the end detects CRC errors
+        if (ok && zip_fread(zf, buffer.get(), 1) != 0) {
+            ok = false;
+        }
+        if (zip_fclose(zf) != 0) {
+            ok = false;
+        }
+
+        if (ok && entry.hashes.crc == st.crc) {
+            add(job.name, st.name, entry);
+        }
+    }
+
+    zip_discard(za);
+}
+
+
+bool PrecomputedHashes::Job::is_cached(const std::string &file_name, time_t mtime, uint64_t size) const {
+    auto it = cached_files.find(file_name);
+
+    return it != cached_files.end() && it->second.mtime == mtime && it->second.hashes.size == size && it->second.hashes.has_all_types(hashtypes);
+}
@@ -0,0 +1,101 @@
+#ifndef HAD_PRECOMPUTED_HASHES_H
+#define HAD_PRECOMPUTED_HASHES_H
+
+/*
+PrecomputedHashes.h -- hashes of ROM set files computed by worker threads
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <ctime>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "File.h"
+#include "Hashes.h"
+#include "ThreadPool.h"
+
+class PrecomputedHashes;
+
+typedef std::shared_ptr<PrecomputedHashes> PrecomputedHashesPtr;
+
+// Computes hashes of files in ROM set archives ahead of time in worker threads.
+// Only hashes are computed in parallel; opening archives, checking games, and all output happen in the main thread, so results are independent of the number of threads.
+class PrecomputedHashes {
+public:
+    typedef std::vector<std::future<void>> Batch;
+
+    explicit PrecomputedHashes(size_t threads) : pool(threads) { }
+
+    Batch compute(const std::vector<std::string> &archive_names);
+    void forget(const std::vector<std::string> &archive_names);
+    bool get(const std::string &archive_name, const File &file, Hashes *hashes);
+
+    size_t threads() const { return pool.size(); }
+    
+private:
+    class Entry {
+    public:
+        Entry() : mtime(0) { }
+
+        time_t mtime;
+        Hashes hashes;
+    };
+
+    class Job {
+    public:
+        Job(std::string name_, bool zipped_, int hashtypes_) : name(std::move(name_)), zipped(zipped_), hashtypes(hashtypes_) { }
+
+        std::string name;
+        bool zipped;
+        int hashtypes;
+        std::unordered_map<std::string, File> cached_files;
+
+        [[nodiscard]] bool is_cached(const std::string &file_name, time_t mtime, uint64_t size) const;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, std::unordered_map<std::string, Entry>> entries;
+    ThreadPool pool; // must be last, so workers are stopped before the other members are destroyed
+
+    bool prepare_job(Job *job);
+    void add(const std::string &archive_name, const std::string &file_name, const Entry &entry);
+    void compute_dir(const Job &job);
+    void compute_zip(const Job &job);
+};
+
+extern PrecomputedHashesPtr precomputed_hashes;
+
+#endif // HAD_PRECOMPUTED_HASHES_H
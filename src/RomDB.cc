@@ -33,9 +33,13 @@
 
 #include "RomDB.h"
 
+#include <limits>
+
 #include "Exception.h"
 #include "globals.h"
 
+#define GAME_CACHE_SIZE 1024
+
 std::unique_ptr<RomDB> db;
 std::unique_ptr<RomDB> old_db;
 
@@ -125,6 +129,7 @@ std::unordered_map<int, std::string> RomDB::queries = {
     {  QUERY_HASH_TYPE_CRC, "select name from file where file_type = :file_type and crc not null limit 1" },
     {  QUERY_HASH_TYPE_MD5, "select name from file where file_type = :file_type and md5 not null limit 1" },
     {  QUERY_HASH_TYPE_SHA1, "select name from file where file_type = :file_type and sha1 not null limit 1" },
+    {  QUERY_LIST_CRC, "select crc from file where file_type = :file_type and status <> :status" },
     {  QUERY_LIST_DISK, "select distinct name from file where file_type = 1 order by name" },
     {  QUERY_LIST_GAME, "select name from game order by name" },
     {  QUERY_PARENT_BY_NAME, "select parent from game where name = :name" },
@@ -138,7 +143,7 @@ std::unordered_map<int, std::string> RomDB::queries = {
 };
 
 std::unordered_map<int, std::string> RomDB::parameterized_queries = {
-   {  QUERY_FILE_FBH, "select g.name as game_name, g.dat_idx, f.file_idx, f.name, f.size, f.crc, f.md5, f.sha1 from game g, file f where f.game_id = g.game_id and f.file_type = :file_type and f.status <> :status @HASH@" },
+   {  QUERY_FILE_FBH, "select g.name as game_name, g.dat_idx, f.file_idx, f.name, f.size, f.crc, f.md5, f.sha1 from game g, file f where f.game_id = g.game_id and f.file_type = :file_type and f.status <> :status @HASH@ order by f.rowid" },
 
 };
 
@@ -210,6 +215,9 @@ bool RomDB::has_disks() {
 
 
 int RomDB::hashtypes(filetype_t type) {
+    if (snapshot) {
+        return snapshot->hashtypes(type);
+    }
     if (hashtypes_[type] == -1) {
         read_hashtypes(type);
     }
@@ -218,10 +226,14 @@ int RomDB::hashtypes(filetype_t type) {
 }
 
 
-RomDB::RomDB(const std::string &name, int mode) : DB(format, name, mode) {
+RomDB::RomDB(const std::string &name, int mode) : DB(format, name, mode), game_cache(GAME_CACHE_SIZE), read_only((mode & DBH_WRITE) == 0), crc_filter_initialized(false) {
     for (size_t i = 0; i < TYPE_MAX; i++) {
 	hashtypes_[i] = -1;
     }
+
+    if (read_only) {
+        snapshot = RomDBSnapshot::open(name);
+    }
     
     auto stmt = get_statement(QUERY_DAT_DETECTOR);
 
@@ -369,30 +381,109 @@ bool RomDB::read_rules(Detector *detector) {
 
 
 std::vector<RomLocation> RomDB::read_file_by_hash(filetype_t ft, const Hashes &hashes) {
-    auto stmt = get_statement(QUERY_FILE_FBH, hashes, false);
-    
-    stmt->set_int("file_type", ft);
-    stmt->set_int("status", Rom::NO_DUMP);
-    stmt->set_hashes(hashes, false);
-
     std::vector<RomLocation> result;
 
-    while (stmt->step()) {
-        auto rom = Rom();
-        rom.name = stmt->get_string("name");
-        rom.hashes = stmt->get_hashes();
-        rom.hashes.size = stmt->get_uint64("size", Hashes::SIZE_UNKNOWN);
+    // The lookup doesn't match on size, so the filter is keyed on crc only.
+    auto use_filter = ft == TYPE_ROM && hashes.has_type(Hashes::TYPE_CRC);
+    if (use_filter) {
+        if (!crc_filter_initialized) {
+            init_crc_filter();
+        }
+        if (!crc_filter) {
+            use_filter = false;
+        }
+        else if (!crc_filter->may_contain(hashes.crc)) {
+            filter_statistics.rejected += 1;
+            return result;
+        }
+        else {
+            filter_statistics.passed += 1;
+        }
+    }
 
-        result.emplace_back(stmt->get_string("game_name"), get_detector_id_for_dat(stmt->get_uint64("dat_idx")), static_cast<size_t>(stmt->get_int("file_idx")), rom);
+    if (snapshot) {
+        std::vector<std::pair<size_t, size_t>> matches;
+        snapshot->read_file_by_hash(ft, hashes, &matches);
+        for (auto &match : matches) {
+            result.emplace_back(snapshot->game_name(match.first), get_detector_id_for_dat(snapshot->game_dat(match.first)), snapshot->rom_file_index(match.second), snapshot->rom(match.second));
+        }
+    }
+    else {
+        auto stmt = get_statement(QUERY_FILE_FBH, hashes, false);
+
+        stmt->set_int("file_type", ft);
+        stmt->set_int("status", Rom::NO_DUMP);
+        stmt->set_hashes(hashes, false);
+
+        while (stmt->step()) {
+            auto rom = Rom();
+            rom.name = stmt->get_string("name");
+            rom.hashes = stmt->get_hashes();
+            rom.hashes.size = stmt->get_uint64("size", Hashes::SIZE_UNKNOWN);
+
+            result.emplace_back(stmt->get_string("game_name"), get_detector_id_for_dat(stmt->get_uint64("dat_idx")), static_cast<size_t>(stmt->get_int("file_idx")), rom);
+        }
+    }
+
+    if (use_filter && result.empty()) {
+        filter_statistics.unmatched += 1;
     }
 
     return result;
 }
 
 
+void RomDB::init_crc_filter() {
+    crc_filter_initialized = true;
+
+    // A writable database can change under the filter.
+    if (!read_only) {
+        return;
+    }
+
+    std::vector<uint32_t> crcs;
+    auto stmt = get_statement(QUERY_LIST_CRC);
+    stmt->set_int("file_type", TYPE_ROM);
+    stmt->set_int("status", Rom::NO_DUMP);
+
+    while (stmt->step()) {
+        auto crc = stmt->get_int64("crc", std::numeric_limits<int64_t>::min());
+        if (crc == std::numeric_limits<int64_t>::min()) {
+            // Roms without crc match any crc, so the filter could not reject anything.
+            return;
+        }
+        crcs.push_back(static_cast<uint32_t>(crc & 0xffffffff));
+    }
+
+    crc_filter = BloomFilter(crcs.size());
+    for (auto crc : crcs) {
+        crc_filter->add(crc);
+    }
+}
+
+
 static std::string chd_extension = ".chd";
 
 GamePtr RomDB::read_game(const std::string &name) {
+    auto cached = game_cache.get(name);
+    if (cached.has_value()) {
+        return std::make_shared<Game>(*cached.value());
+    }
+
+    auto game = read_game_from_db(name);
+    if (game) {
+        game_cache.put(name, std::make_shared<Game>(*game));
+    }
+
+    return game;
+}
+
+
+GamePtr RomDB::read_game_from_db(const std::string &name) {
+    if (snapshot) {
+        return snapshot->read_game(name);
+    }
+
     auto stmt = get_statement(QUERY_GAME);
 
     stmt->set_string("name", name);
@@ -452,6 +543,10 @@ std::vector<std::string> RomDB::read_list(enum dbh_list type) {
         { DBH_KEY_LIST_GAME, QUERY_LIST_GAME }
     };
     
+    if (snapshot && type == DBH_KEY_LIST_GAME) {
+        return snapshot->read_game_list();
+    }
+
     auto it = query_list.find(type);
     if (it == query_list.end()) {
         throw Exception("unknown type %d", type);
@@ -551,6 +646,8 @@ void RomDB::write_rules(const Detector &detector) {
 
 
 void RomDB::delete_game(const std::string &name) {
+    game_cache.clear();
+
     auto stmt = get_statement(QUERY_GAME_ID);
 
     stmt->set_string("name", name);
@@ -583,6 +680,8 @@ void RomDB::delete_game(const std::string &name) {
 
 
 void RomDB::update_file_location(Game *game) {
+    game_cache.clear();
+
     auto stmt = get_statement(UPDATE_FILE);
 
     //     {  UPDATE_FILE, "update file set location = :location where game_id = :game_id and file_type = :file_type and file_idx = :file_idx" },
@@ -607,6 +706,8 @@ void RomDB::update_file_location(Game *game) {
 
 
 void RomDB::update_game_parent(const Game *game) {
+    game_cache.clear();
+
     auto stmt = get_statement(UPDATE_PARENT);
 
     stmt->set_string("parent", game->cloneof[0]);
@@ -617,7 +718,11 @@ void RomDB::update_game_parent(const Game *game) {
 
 void RomDB::write_game(Game *game) {
     delete_game(game);
+    insert_game(game);
+}
+
 
+void RomDB::insert_game(Game *game) {
     auto stmt = get_statement(INSERT_GAME);
 
     stmt->set_string("name", game->name);
@@ -688,7 +793,8 @@ int RomDB::export_db(const std::unordered_set<std::string> &exclude, const DatEn
     }
 
     for (const auto &name : list) {
-        GamePtr game = read_game(name);
+        // Not cached: every game is read only once and the output context may modify it.
+        GamePtr game = read_game_from_db(name);
         if (!game) {
 	    /* TODO: error */
 	    continue;
@@ -34,10 +34,15 @@
   IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <optional>
 #include <unordered_set>
 
+#include "BloomFilter.h"
 #include "DB.h"
+#include "Game.h"
+#include "LruCache.h"
 #include "RomLocation.h"
+#include "RomDBSnapshot.h"
 #include "OutputContext.h"
 #include "Stats.h"
 
@@ -63,6 +68,7 @@ public:
         QUERY_HASH_TYPE_CRC,
         QUERY_HASH_TYPE_MD5,
         QUERY_HASH_TYPE_SHA1,
+        QUERY_LIST_CRC,
         QUERY_LIST_DISK,
         QUERY_LIST_GAME,
         QUERY_PARENT_BY_NAME,
@@ -90,6 +96,18 @@ public:
     
     std::unordered_map<size_t, DetectorPtr> detectors;
 
+    // read_game returns copies of the cached games, since callers may modify them; any write to the database clears the cache.
+    LruCache<std::string, GamePtr> game_cache;
+
+    // Counters for lookups by hash checked against the crc filter: rejected without querying the database, or passed to the query.
+    // Passed lookups are unmatched if no rom was found, either because the crc is not in the database (a false positive of the filter) or because the other hashes differ.
+    struct FilterStatistics {
+        uint64_t rejected = 0;
+        uint64_t passed = 0;
+        uint64_t unmatched = 0;
+    };
+    FilterStatistics filter_statistics;
+
     Stats get_stats();
     std::vector<std::string> get_clones(const std::string &game_name);
     void delete_game(const Game *game) { delete_game(game->name); }
@@ -110,6 +128,8 @@ public:
     void write_dat(const std::vector<DatEntry> &dats);
     void write_detector(const Detector &detector);
     void write_game(Game *game);
+    // Like write_game, but the game must not be in the database yet.
+    void insert_game(Game *game);
     void write_hashtypes(int, int);
     int export_db(const std::unordered_set<std::string> &exclude, const DatEntry *dat, OutputContext *out);
     
@@ -118,6 +138,12 @@ protected:
     
 private:
     int hashtypes_[TYPE_MAX];
+    // Used for reading if the database is opened read-only and an up to date snapshot exists.
+    std::unique_ptr<RomDBSnapshot> snapshot;
+    bool read_only;
+    // Crcs of all roms, built on first lookup by hash if the database is opened read-only and every rom has a crc.
+    std::optional<BloomFilter> crc_filter;
+    bool crc_filter_initialized;
     
     static const std::string init2_sql;
     static const Statement query_hash_type[];
@@ -127,8 +153,10 @@ private:
     DBStatement *get_statement(Statement name) { return get_statement_internal(name); }
     DBStatement *get_statement(ParameterizedStatement name, const Hashes &hashes, bool have_size) { return get_statement_internal(name, hashes, have_size); }
 
+    void init_crc_filter();
     DetectorPtr read_detector();
     void read_files(Game *game, filetype_t ft);
+    GamePtr read_game_from_db(const std::string &name);
     void read_hashtypes(filetype_t type);
     bool read_rules(Detector *detector);
     void write_files(Game *game, filetype_t ft);
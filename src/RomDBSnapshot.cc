@@ -0,0 +1,664 @@
+/*
+RomDBSnapshot.cc -- memory mapped read-only image of ROM database
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "RomDBSnapshot.h"
+
+#include "config.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <unordered_map>
+
+#include <fcntl.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "DBStatement.h"
+#include "Exception.h"
+#include "RomDB.h"
+
+#define SNAPSHOT_MAGIC "CKMROMDB"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+
+#define HASH_TYPES 3
+
+#define ROM_HAVE_SIZE 1
+
+struct RomDBSnapshot::IndexRecord {
+    uint64_t sorted_offset; // roms that have this hash, sorted by hash and rom index
+    uint64_t sorted_count;
+    uint64_t missing_offset; // roms that don't have this hash, by rom index
+    uint64_t missing_count;
+};
+
+struct RomDBSnapshot::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    int64_t db_mtime;
+    uint64_t db_size;
+    uint64_t game_count;
+    uint64_t rom_count;
+    uint64_t index_count;
+    uint64_t strings_size;
+    uint32_t hashtypes[TYPE_MAX];
+    IndexRecord indexes[TYPE_MAX][HASH_TYPES];
+};
+
+// Sorted by name.
+struct RomDBSnapshot::GameRecord {
+    uint64_t name;
+    uint64_t description;
+    uint64_t cloneof[2];
+    uint64_t id;
+    uint64_t dat_no;
+    uint64_t first_rom[TYPE_MAX];
+    uint64_t rom_count[TYPE_MAX];
+};
+
+// In database order (rowid), so that results come out in the same order as from the database.
+struct RomDBSnapshot::RomRecord {
+    uint64_t name;
+    uint64_t merge;
+    uint64_t size;
+    uint32_t crc;
+    uint32_t game; // index into games
+    uint32_t file_index;
+    uint8_t filetype;
+    uint8_t status;
+    int8_t location;
+    uint8_t types;
+    uint8_t flags;
+    uint8_t md5[Hashes::SIZE_MD5];
+    uint8_t sha1[Hashes::SIZE_SHA1];
+    uint8_t padding[7];
+};
+
+namespace {
+int hash_type(size_t index) {
+    return 1 << index;
+}
+
+int compare_hash(const void *a, const void *b, int type) {
+    return memcmp(a, b, Hashes::hash_size(type));
+}
+
+bool get_db_state(const std::string &name, int64_t *mtime, uint64_t *size) {
+    std::error_code ec;
+
+    auto time = std::filesystem::last_write_time(name, ec);
+    if (ec) {
+        return false;
+    }
+    *size = std::filesystem::file_size(name, ec);
+    if (ec) {
+        return false;
+    }
+    *mtime = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+// Map the snapshot into memory, or read it if mapping is not available. Returns nullptr on failure.
+void *load_data(int fd, size_t size) {
+#ifdef HAVE_MMAP
+    auto data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    return data == MAP_FAILED ? nullptr : data;
+#else
+    // malloc is aligned for all records.
+    auto data = malloc(size);
+    if (data == nullptr) {
+        return nullptr;
+    }
+    size_t done = 0;
+    while (done < size) {
+        auto n = read(fd, static_cast<uint8_t *>(data) + done, size - done);
+        if (n <= 0) {
+            free(data);
+            return nullptr;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return data;
+#endif
+}
+
+void unload_data(void *data, size_t size) {
+#ifdef HAVE_MMAP
+    munmap(data, size);
+#else
+    free(data);
+#endif
+}
+
+class StringTable {
+public:
+    std::vector<char> data;
+
+    StringTable() {
+        add("");
+    }
+
+    uint64_t add(const std::string &string) {
+        auto it = offsets.find(string);
+        if (it != offsets.end()) {
+            return it->second;
+        }
+        auto offset = data.size();
+        data.insert(data.end(), string.begin(), string.end());
+        data.push_back('\0');
+        offsets[string] = offset;
+        return offset;
+    }
+
+private:
+    std::unordered_map<std::string, uint64_t> offsets;
+};
+}
+
+
+RomDBSnapshot::RomDBSnapshot(void *data_, size_t size_) : data(data_), data_size(size_) {
+    header = static_cast<const Header *>(data);
+    auto base = static_cast<const uint8_t *>(data) + sizeof(Header);
+    games = reinterpret_cast<const GameRecord *>(base);
+    roms = reinterpret_cast<const RomRecord *>(games + header->game_count);
+    indices = reinterpret_cast<const uint32_t *>(roms + header->rom_count);
+    strings = reinterpret_cast<const char *>(indices + header->index_count);
+}
+
+
+RomDBSnapshot::~RomDBSnapshot() {
+    unload_data(data, data_size);
+}
+
+
+std::unique_ptr<RomDBSnapshot> RomDBSnapshot::open(const std::string &db_file_name) {
+    int64_t db_mtime;
+    uint64_t db_size;
+
+    if (!get_db_state(db_file_name, &db_mtime, &db_size)) {
+        return nullptr;
+    }
+
+    auto name = file_name(db_file_name);
+    auto fd = ::open(name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) < 0 || static_cast<uint64_t>(st.st_size) < sizeof(Header)) {
+        close(fd);
+        return nullptr;
+    }
+
+    auto size = static_cast<size_t>(st.st_size);
+    auto data = load_data(fd, size);
+    close(fd);
+    if (data == nullptr) {
+        return nullptr;
+    }
+
+    auto header = static_cast<const Header *>(data);
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 || header->version != SNAPSHOT_VERSION || header->byte_order != SNAPSHOT_BYTE_ORDER || header->db_mtime != db_mtime || header->db_size != db_size) {
+        unload_data(data, size);
+        return nullptr;
+    }
+
+    auto available = size - sizeof(Header);
+    if (header->game_count > available / sizeof(GameRecord) || header->rom_count > available / sizeof(RomRecord) || header->index_count > available / sizeof(uint32_t)) {
+        unload_data(data, size);
+        return nullptr;
+    }
+    auto records_size = header->game_count * sizeof(GameRecord) + header->rom_count * sizeof(RomRecord) + header->index_count * sizeof(uint32_t);
+    if (records_size > available || header->strings_size != available - records_size || header->strings_size == 0) {
+        unload_data(data, size);
+        return nullptr;
+    }
+
+    auto snapshot = std::unique_ptr<RomDBSnapshot>(new RomDBSnapshot(data, size));
+    if (!snapshot->validate()) {
+        return nullptr;
+    }
+
+    return snapshot;
+}
+
+
+bool RomDBSnapshot::validate() const {
+    auto strings_size = header->strings_size;
+
+    if (strings[strings_size - 1] != '\0') {
+        return false;
+    }
+    for (uint64_t i = 0; i < header->game_count; i++) {
+        const auto &game = games[i];
+        if (game.name >= strings_size || game.description >= strings_size || game.cloneof[0] >= strings_size || game.cloneof[1] >= strings_size) {
+            return false;
+        }
+        for (size_t ft = 0; ft < TYPE_MAX; ft++) {
+            if (game.first_rom[ft] > header->rom_count || game.rom_count[ft] > header->rom_count - game.first_rom[ft]) {
+                return false;
+            }
+        }
+    }
+    for (uint64_t i = 0; i < header->rom_count; i++) {
+        const auto &rom = roms[i];
+        if (rom.name >= strings_size || rom.merge >= strings_size || rom.game >= header->game_count || rom.filetype >= TYPE_MAX) {
+            return false;
+        }
+    }
+    for (uint64_t i = 0; i < header->index_count; i++) {
+        if (indices[i] >= header->rom_count) {
+            return false;
+        }
+    }
+    for (size_t ft = 0; ft < TYPE_MAX; ft++) {
+        for (size_t type = 0; type < HASH_TYPES; type++) {
+            const auto &index = header->indexes[ft][type];
+            if (index.sorted_offset > header->index_count || index.sorted_count > header->index_count - index.sorted_offset || index.missing_offset > header->index_count || index.missing_count > header->index_count - index.missing_offset) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+int RomDBSnapshot::hashtypes(filetype_t filetype) const {
+    return static_cast<int>(header->hashtypes[filetype]);
+}
+
+
+GamePtr RomDBSnapshot::read_game(const std::string &name) const {
+    auto record = find_game(name);
+    if (record == nullptr) {
+        return nullptr;
+    }
+
+    auto game = std::make_shared<Game>();
+    game->id = record->id;
+    game->name = name;
+    game->description = string(record->description);
+    game->dat_no = record->dat_no;
+    game->cloneof[0] = string(record->cloneof[0]);
+    game->cloneof[1] = string(record->cloneof[1]);
+
+    for (size_t ft = 0; ft < TYPE_MAX; ft++) {
+        game->files[ft].reserve(record->rom_count[ft]);
+        for (uint64_t i = 0; i < record->rom_count[ft]; i++) {
+            const auto &rom_record = roms[record->first_rom[ft] + i];
+            auto rom_ = rom(record->first_rom[ft] + i);
+            rom_.merge = string(rom_record.merge);
+            rom_.status = static_cast<Rom::Status>(rom_record.status);
+            rom_.where = static_cast<where_t>(rom_record.location);
+            game->files[ft].push_back(rom_);
+        }
+    }
+
+    return game;
+}
+
+
+std::vector<std::string> RomDBSnapshot::read_game_list() const {
+    std::vector<std::string> list;
+
+    list.reserve(header->game_count);
+    for (uint64_t i = 0; i < header->game_count; i++) {
+        list.emplace_back(string(games[i].name));
+    }
+
+    return list;
+}
+
+
+void RomDBSnapshot::read_file_by_hash(filetype_t filetype, const Hashes &hashes, std::vector<std::pair<size_t, size_t>> *result) const {
+    // Like the database, return matches in rowid order, which is rom index order.
+    size_t primary = HASH_TYPES;
+    for (size_t type = 0; type < HASH_TYPES; type++) {
+        if (hashes.has_type(hash_type(type))) {
+            primary = type;
+            break;
+        }
+    }
+
+    auto add = [&](size_t rom_index) {
+        if (matches(roms[rom_index], filetype, hashes)) {
+            result->emplace_back(roms[rom_index].game, rom_index);
+        }
+    };
+
+    if (primary == HASH_TYPES) {
+        for (uint64_t i = 0; i < header->rom_count; i++) {
+            add(i);
+        }
+        return;
+    }
+
+    const auto &index = header->indexes[filetype][primary];
+    auto type = hash_type(primary);
+    auto begin = indices + index.sorted_offset;
+    auto end = begin + index.sorted_count;
+
+    auto it = std::lower_bound(begin, end, hashes, [this, type](uint32_t rom_index, const Hashes &h) {
+        const auto &record = roms[rom_index];
+        switch (type) {
+            case Hashes::TYPE_CRC:
+                return record.crc < h.crc;
+            case Hashes::TYPE_MD5:
+                return compare_hash(record.md5, h.md5.data(), type) < 0;
+            default:
+                return compare_hash(record.sha1, h.sha1.data(), type) < 0;
+        }
+    });
+
+    for (; it != end; ++it) {
+        const auto &record = roms[*it];
+        auto equal = false;
+        switch (type) {
+            case Hashes::TYPE_CRC:
+                equal = record.crc == hashes.crc;
+                break;
+            case Hashes::TYPE_MD5:
+                equal = compare_hash(record.md5, hashes.md5.data(), type) == 0;
+                break;
+            default:
+                equal = compare_hash(record.sha1, hashes.sha1.data(), type) == 0;
+                break;
+        }
+        if (!equal) {
+            break;
+        }
+        add(*it);
+    }
+
+    for (uint64_t i = 0; i < index.missing_count; i++) {
+        add(indices[index.missing_offset + i]);
+    }
+
+    std::sort(result->begin(), result->end(), [](const std::pair<size_t, size_t> &a, const std::pair<size_t, size_t> &b) {
+        return a.second < b.second;
+    });
+}
+
+
+std::string RomDBSnapshot::game_name(size_t game) const {
+    return string(games[game].name);
+}
+
+
+uint64_t RomDBSnapshot::game_dat(size_t game) const {
+    return games[game].dat_no;
+}
+
+
+Rom RomDBSnapshot::rom(size_t rom_index) const {
+    const auto &record = roms[rom_index];
+    Rom rom_;
+
+    rom_.name = string(record.name);
+    if (record.types & Hashes::TYPE_CRC) {
+        rom_.hashes.set_crc(record.crc);
+    }
+    if (record.types & Hashes::TYPE_MD5) {
+        rom_.hashes.set_md5(record.md5);
+    }
+    if (record.types & Hashes::TYPE_SHA1) {
+        rom_.hashes.set_sha1(record.sha1);
+    }
+    rom_.hashes.size = (record.flags & ROM_HAVE_SIZE) ? record.size : Hashes::SIZE_UNKNOWN;
+
+    return rom_;
+}
+
+
+size_t RomDBSnapshot::rom_file_index(size_t rom_index) const {
+    return roms[rom_index].file_index;
+}
+
+
+const RomDBSnapshot::GameRecord *RomDBSnapshot::find_game(const std::string &name) const {
+    auto end = games + header->game_count;
+    auto it = std::lower_bound(games, end, name, [this](const GameRecord &record, const std::string &n) {
+        return n.compare(string(record.name)) > 0;
+    });
+
+    if (it == end || name != string(it->name)) {
+        return nullptr;
+    }
+    return it;
+}
+
+
+bool RomDBSnapshot::matches(const RomRecord &record, filetype_t filetype, const Hashes &hashes) const {
+    if (record.filetype != filetype || record.status == Rom::NO_DUMP) {
+        return false;
+    }
+    if (hashes.has_type(Hashes::TYPE_CRC) && (record.types & Hashes::TYPE_CRC) && record.crc != hashes.crc) {
+        return false;
+    }
+    if (hashes.has_type(Hashes::TYPE_MD5) && (record.types & Hashes::TYPE_MD5) && compare_hash(record.md5, hashes.md5.data(), Hashes::TYPE_MD5) != 0) {
+        return false;
+    }
+    if (hashes.has_type(Hashes::TYPE_SHA1) && (record.types & Hashes::TYPE_SHA1) && compare_hash(record.sha1, hashes.sha1.data(), Hashes::TYPE_SHA1) != 0) {
+        return false;
+    }
+    return true;
+}
+
+
+bool RomDBSnapshot::write(RomDB *db, const std::string &db_file_name) {
+    StringTable string_table;
+    std::vector<GameRecord> game_records;
+    std::vector<RomRecord> rom_records;
+    std::unordered_map<uint64_t, size_t> game_by_id;
+    std::unordered_map<std::string, std::string> parents;
+
+    {
+        DBStatement stmt(db->db, "select game_id, name, parent, description, dat_idx from game order by name, game_id");
+
+        while (stmt.step()) {
+            auto name = stmt.get_string("name");
+            GameRecord record{};
+            record.id = stmt.get_uint64("game_id");
+            record.name = string_table.add(name);
+            record.description = string_table.add(stmt.get_string("description"));
+            auto parent = stmt.get_string("parent");
+            record.cloneof[0] = string_table.add(parent);
+            record.dat_no = stmt.get_uint64("dat_idx");
+            // For duplicate names, the database returns the first one.
+            parents.emplace(name, parent);
+            game_by_id[record.id] = game_records.size();
+            game_records.push_back(record);
+        }
+    }
+
+    for (auto &record : game_records) {
+        auto parent = std::string(string_table.data.data() + record.cloneof[0]);
+        if (!parent.empty()) {
+            auto it = parents.find(parent);
+            if (it != parents.end()) {
+                record.cloneof[1] = string_table.add(it->second);
+            }
+        }
+    }
+
+    {
+        DBStatement stmt(db->db, "select game_id, file_type, file_idx, name, merge, status, location, size, crc, md5, sha1 from file order by rowid");
+        std::vector<std::vector<bool>> seen(game_records.size(), std::vector<bool>(TYPE_MAX));
+        uint64_t last_game = UINT64_MAX;
+        int last_filetype = -1;
+
+        while (stmt.step()) {
+            auto it = game_by_id.find(stmt.get_uint64("game_id"));
+            if (it == game_by_id.end()) {
+                continue;
+            }
+            auto game = it->second;
+            auto filetype = stmt.get_int("file_type");
+            if (filetype < 0 || filetype >= TYPE_MAX) {
+                throw Exception("invalid file type %d", filetype);
+            }
+            auto &game_record = game_records[game];
+
+            if (game != last_game || filetype != last_filetype) {
+                // Roms of a game are looked up as one range per file type.
+                if (seen[game][static_cast<size_t>(filetype)]) {
+                    // files of game are not stored together
+                    return false;
+                }
+                seen[game][static_cast<size_t>(filetype)] = true;
+                game_record.first_rom[filetype] = rom_records.size();
+                last_game = game;
+                last_filetype = filetype;
+            }
+            if (stmt.get_uint64("file_idx") != game_record.rom_count[filetype]) {
+                // files of game are not stored in order
+                return false;
+            }
+            game_record.rom_count[filetype] += 1;
+
+            RomRecord record{};
+            record.name = string_table.add(stmt.get_string("name"));
+            record.merge = string_table.add(stmt.get_string("merge"));
+            record.game = static_cast<uint32_t>(game);
+            record.file_index = static_cast<uint32_t>(stmt.get_uint64("file_idx"));
+            record.filetype = static_cast<uint8_t>(filetype);
+            record.status = static_cast<uint8_t>(stmt.get_int("status"));
+            record.location = static_cast<int8_t>(stmt.get_int("location"));
+            auto size = stmt.get_uint64("size", Hashes::SIZE_UNKNOWN);
+            if (size != Hashes::SIZE_UNKNOWN) {
+                record.flags |= ROM_HAVE_SIZE;
+                record.size = size;
+            }
+            auto hashes = stmt.get_hashes();
+            record.types = static_cast<uint8_t>(hashes.get_types());
+            if (hashes.has_type(Hashes::TYPE_CRC)) {
+                record.crc = hashes.crc;
+            }
+            if (hashes.has_type(Hashes::TYPE_MD5)) {
+                memcpy(record.md5, hashes.md5.data(), Hashes::SIZE_MD5);
+            }
+            if (hashes.has_type(Hashes::TYPE_SHA1)) {
+                memcpy(record.sha1, hashes.sha1.data(), Hashes::SIZE_SHA1);
+            }
+            rom_records.push_back(record);
+        }
+    }
+
+    Header header{};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    if (!get_db_state(db_file_name, &header.db_mtime, &header.db_size)) {
+        throw Exception("can't stat '%s'", db_file_name.c_str());
+    }
+    header.game_count = game_records.size();
+    header.rom_count = rom_records.size();
+
+    std::vector<uint32_t> index_entries;
+    for (size_t ft = 0; ft < TYPE_MAX; ft++) {
+        header.hashtypes[ft] = static_cast<uint32_t>(db->hashtypes(static_cast<filetype_t>(ft)));
+        for (size_t type_index = 0; type_index < HASH_TYPES; type_index++) {
+            auto type = hash_type(type_index);
+            std::vector<uint32_t> sorted;
+            std::vector<uint32_t> missing;
+
+            for (uint32_t i = 0; i < rom_records.size(); i++) {
+                const auto &record = rom_records[i];
+                if (record.filetype != ft) {
+                    continue;
+                }
+                if (record.types & type) {
+                    sorted.push_back(i);
+                }
+                else {
+                    missing.push_back(i);
+                }
+            }
+
+            std::stable_sort(sorted.begin(), sorted.end(), [&rom_records, type](uint32_t a, uint32_t b) {
+                const auto &record_a = rom_records[a];
+                const auto &record_b = rom_records[b];
+                switch (type) {
+                    case Hashes::TYPE_CRC:
+                        return record_a.crc < record_b.crc;
+                    case Hashes::TYPE_MD5:
+                        return compare_hash(record_a.md5, record_b.md5, type) < 0;
+                    default:
+                        return compare_hash(record_a.sha1, record_b.sha1, type) < 0;
+                }
+            });
+
+            auto &index = header.indexes[ft][type_index];
+            index.sorted_offset = index_entries.size();
+            index.sorted_count = sorted.size();
+            index_entries.insert(index_entries.end(), sorted.begin(), sorted.end());
+            index.missing_offset = index_entries.size();
+            index.missing_count = missing.size();
+            index_entries.insert(index_entries.end(), missing.begin(), missing.end());
+        }
+    }
+    header.index_count = index_entries.size();
+    header.strings_size = string_table.data.size();
+
+    auto name = file_name(db_file_name);
+    auto temp_name = name + ".tmp";
+    auto fp = std::fopen(temp_name.c_str(), "wb");
+    if (fp == nullptr) {
+        throw Exception("can't create '%s': %s", temp_name.c_str(), strerror(errno));
+    }
+
+    auto ok = std::fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = ok && (game_records.empty() || std::fwrite(game_records.data(), sizeof(GameRecord), game_records.size(), fp) == game_records.size());
+    ok = ok && (rom_records.empty() || std::fwrite(rom_records.data(), sizeof(RomRecord), rom_records.size(), fp) == rom_records.size());
+    ok = ok && (index_entries.empty() || std::fwrite(index_entries.data(), sizeof(uint32_t), index_entries.size(), fp) == index_entries.size());
+    ok = ok && std::fwrite(string_table.data.data(), 1, string_table.data.size(), fp) == string_table.data.size();
+    if (std::fclose(fp) != 0) {
+        ok = false;
+    }
+    if (!ok || std::rename(temp_name.c_str(), name.c_str()) != 0) {
+        auto error = std::string(strerror(errno));
+        std::remove(temp_name.c_str());
+        throw Exception("can't write '%s': %s", name.c_str(), error.c_str());
+    }
+
+    return true;
+}
@@ -0,0 +1,91 @@
+#ifndef HAD_ROMDB_SNAPSHOT_H
+#define HAD_ROMDB_SNAPSHOT_H
+
+/*
+RomDBSnapshot.h -- memory mapped read-only image of ROM database
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Game.h"
+#include "RomLocation.h"
+
+class RomDB;
+
+// Read-only image of a ROM database, written by mkmamedb next to the database.
+// It is only used if the database hasn't changed since the image was written.
+class RomDBSnapshot {
+public:
+    ~RomDBSnapshot();
+
+    static std::string file_name(const std::string &db_file_name) { return db_file_name + ".snapshot"; }
+    static std::unique_ptr<RomDBSnapshot> open(const std::string &db_file_name);
+    // Returns false without writing a snapshot if the files of a game are not stored together and in order, since roms are looked up as one range per game.
+    static bool write(RomDB *db, const std::string &db_file_name);
+
+    int hashtypes(filetype_t filetype) const;
+    GamePtr read_game(const std::string &name) const;
+    std::vector<std::string> read_game_list() const;
+    // Returns game index and rom index of matching roms, ordered by rom index (the rowid of the file in the database).
+    void read_file_by_hash(filetype_t filetype, const Hashes &hashes, std::vector<std::pair<size_t, size_t>> *result) const;
+    std::string game_name(size_t game) const;
+    uint64_t game_dat(size_t game) const;
+    Rom rom(size_t rom) const;
+    size_t rom_file_index(size_t rom) const;
+
+private:
+    struct Header;
+    struct GameRecord;
+    struct RomRecord;
+    struct IndexRecord;
+
+    RomDBSnapshot(void *data, size_t size);
+
+    void *data;
+    size_t data_size;
+
+    const Header *header;
+    const GameRecord *games;
+    const RomRecord *roms;
+    const uint32_t *indices;
+    const char *strings;
+
+    bool validate() const;
+    const char *string(uint64_t offset) const { return strings + offset; }
+    const GameRecord *find_game(const std::string &name) const;
+    bool matches(const RomRecord &record, filetype_t filetype, const Hashes &hashes) const;
+};
+
+#endif // HAD_ROMDB_SNAPSHOT_H
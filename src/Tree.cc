@@ -33,12 +33,16 @@
 
 #include "Tree.h"
 
+#include <deque>
+
+#include "ArchivePrefetcher.h"
 #include "check.h"
 #include "check_util.h"
 #include "diagnostics.h"
 #include "fix.h"
 #include "Fixdat.h"
 #include "globals.h"
+#include "PrecomputedHashes.h"
 #include "RomDB.h"
 #include "sighandle.h"
 #include "warn.h"
@@ -109,14 +113,113 @@ bool Tree::recheck_games_needing(filetype_t filetype, uint64_t size, const Hashe
 void Tree::traverse() {
     GameArchives archives[] = { GameArchives(), GameArchives(), GameArchives() };
 
+    if (configuration.jobs > 1) {
+        traverse_parallel(archives);
+        return;
+    }
+    if (configuration.prefetch_depth > 0) {
+        traverse_prefetching(archives);
+        return;
+    }
+
     for (const auto &it : children) {
         it.second->traverse_internal(archives);
     }
 }
 
+
+void Tree::traverse_parallel(GameArchives *archives) {
+    class Subtree {
+    public:
+        explicit Subtree(Tree *tree_) : tree(tree_) { }
+
+        Tree *tree;
+        std::vector<std::string> archive_names;
+        PrecomputedHashes::Batch batch;
+    };
+
+    precomputed_hashes = std::make_shared<PrecomputedHashes>(static_cast<size_t>(configuration.jobs));
+
+    // Keep enough subtrees in flight to keep all worker threads busy while the main thread checks games.
+    auto lookahead = 2 * static_cast<size_t>(configuration.jobs);
+    std::deque<Subtree> pending;
+    auto next = children.begin();
+
+    try {
+        while (next != children.end() || !pending.empty()) {
+            while (next != children.end() && pending.size() < lookahead) {
+                auto &subtree = pending.emplace_back(next->second.get());
+                subtree.tree->collect_archive_names(&subtree.archive_names);
+                subtree.batch = precomputed_hashes->compute(subtree.archive_names);
+                ++next;
+            }
+
+            auto &subtree = pending.front();
+            for (auto &future : subtree.batch) {
+                future.wait();
+            }
+            subtree.tree->traverse_internal(archives);
+            precomputed_hashes->forget(subtree.archive_names);
+            pending.pop_front();
+        }
+    }
+    catch (...) {
+        precomputed_hashes = nullptr;
+        throw;
+    }
+
+    precomputed_hashes = nullptr;
+}
+
+
+void Tree::traverse_prefetching(GameArchives *archives) {
+    class Subtree {
+    public:
+        explicit Subtree(Tree *tree_) : tree(tree_) { }
+
+        Tree *tree;
+        ArchivePrefetcher::Batch batch;
+    };
+
+    auto depth = static_cast<size_t>(configuration.prefetch_depth);
+    ArchivePrefetcher prefetcher(depth);
+    std::deque<Subtree> pending;
+    auto next = children.begin();
+
+    while (next != children.end() || !pending.empty()) {
+        while (next != children.end() && pending.size() <= depth) {
+            auto &subtree = pending.emplace_back(next->second.get());
+            std::vector<std::string> archive_names;
+            subtree.tree->collect_archive_names(&archive_names);
+            subtree.batch = prefetcher.prefetch(archive_names);
+            ++next;
+        }
+
+        auto &subtree = pending.front();
+        ArchivePrefetcher::wait(&subtree.batch);
+        subtree.tree->traverse_internal(archives);
+        pending.pop_front();
+    }
+}
+
+
+void Tree::collect_archive_names(std::vector<std::string> *archive_names) const {
+    if (check && !checked) {
+        auto full_name = findfile(TYPE_ROM, name);
+        if (!full_name.empty()) {
+            archive_names->push_back(full_name);
+        }
+    }
+
+    for (const auto &it : children) {
+        it.second->collect_archive_names(archive_names);
+    }
+}
+
 void Tree::traverse_internal(GameArchives *ancestor_archives) {
     GameArchives archives[] = { GameArchives(), ancestor_archives[0], ancestor_archives[1] };
     
+    check_interrupted();
     if (siginfo_caught) {
         print_info("currently checking " + name);
     }
@@ -38,6 +38,7 @@
 #include <memory>
 
 #include <string>
+#include <vector>
 
 #include "GameArchives.h"
 #include "Hashes.h"
@@ -68,7 +69,10 @@ public:
     
 private:
     Tree *add_node(const std::string &game_name, bool check);
+    void collect_archive_names(std::vector<std::string> *archive_names) const;
     void traverse_internal(GameArchives *ancestor_archives);
+    void traverse_parallel(GameArchives *archives);
+    void traverse_prefetching(GameArchives *archives);
     void process(GameArchives *archives);
 };
 
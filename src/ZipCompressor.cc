@@ -0,0 +1,413 @@
+/*
+ZipCompressor.cc -- compress files for zip archives in parallel
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ZipCompressor.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <mutex>
+
+#include <unistd.h>
+#include <zlib.h>
+
+#include "Exception.h"
+#include "ThreadPool.h"
+
+#if LIBZIP_VERSION_MAJOR > 1 || (LIBZIP_VERSION_MAJOR == 1 && LIBZIP_VERSION_MINOR >= 10)
+#define HAVE_LAYERED_SOURCES
+#endif
+
+// Smaller files are compressed quickly, and libzip may decide to store them uncompressed.
+const uint64_t ZipCompressor::MINIMUM_SIZE = 256 * 1024;
+const uint64_t ZipCompressor::MAXIMUM_SIZE = 1024 * 1024 * 1024;
+const uint64_t ZipCompressor::MAXIMUM_IN_FLIGHT_SIZE = 256 * 1024 * 1024;
+
+namespace {
+// Temporary file holding the compressed data of all files of one archive.
+class Spool {
+public:
+    Spool() : file(std::tmpfile()), size(0) { }
+    ~Spool() {
+        if (file != nullptr) {
+            fclose(file);
+        }
+    }
+
+    bool append(const std::vector<uint8_t> &data, uint64_t *offset);
+    bool read(uint64_t offset, void *data, size_t length) const;
+
+    FILE *file;
+
+private:
+    std::mutex mutex;
+    uint64_t size;
+};
+
+class Job {
+public:
+    Job(ZipSourcePtr *source_, uint64_t size_) : source(source_), size(size_), offset(0), compressed_size(0), crc(0), ok(false) { }
+
+    ZipSourcePtr *source;
+    uint64_t size;
+    std::vector<uint8_t> data;
+    uint64_t offset;
+    uint64_t compressed_size;
+    uint32_t crc;
+    bool ok;
+    std::future<void> future;
+
+    bool read();
+    void compress(Spool *spool, int level);
+};
+
+#ifdef HAVE_LAYERED_SOURCES
+// Layered on top of the original source, so libzip takes the remaining file attributes from it.
+class CompressedData {
+public:
+    CompressedData(std::shared_ptr<Spool> spool_, const Job &job, uint16_t bit_flags_) : spool(std::move(spool_)), offset(job.offset), size(job.size), compressed_size(job.compressed_size), crc(job.crc), bit_flags(bit_flags_), position(0) { zip_error_init(&error); }
+    ~CompressedData() { zip_error_fini(&error); }
+
+    std::shared_ptr<Spool> spool;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t compressed_size;
+    uint32_t crc;
+    uint16_t bit_flags;
+    uint64_t position;
+    zip_error_t error;
+};
+
+zip_int64_t compressed_data_callback(zip_source_t *source, void *ud, void *data, zip_uint64_t length, zip_source_cmd_t command);
+
+// General purpose bit flags libzip sets for deflate compression level.
+uint16_t general_purpose_bit_flags(int level) {
+    if (level < 3) {
+        return 2 << 1;
+    }
+    else if (level > 7) {
+        return 1 << 1;
+    }
+    return 0;
+}
+#endif
+}
+
+
+bool ZipCompressor::is_supported() {
+#ifdef HAVE_LAYERED_SOURCES
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+void ZipCompressor::compress(const std::vector<ZipSourcePtr *> &sources) const {
+#ifdef HAVE_LAYERED_SOURCES
+    if (threads < 2) {
+        return;
+    }
+
+    std::vector<ZipSourcePtr *> candidates;
+    for (auto source : sources) {
+        if (*source && is_candidate((*source)->source)) {
+            candidates.push_back(source);
+        }
+    }
+    // files are compressed in parallel to each other
+    if (candidates.size() < 2) {
+        return;
+    }
+
+    auto spool = std::make_shared<Spool>();
+    if (spool->file == nullptr) {
+        return;
+    }
+
+    std::vector<std::shared_ptr<Job>> jobs;
+
+    {
+        ThreadPool pool(std::min(threads, candidates.size()));
+        uint64_t in_flight_size = 0;
+        size_t first_in_flight = 0;
+        auto compression_level = level;
+
+        for (auto source : candidates) {
+            zip_stat_t st;
+            zip_stat_init(&st);
+            if (zip_source_stat((*source)->source, &st) < 0) {
+                continue;
+            }
+
+            auto job = std::make_shared<Job>(source, st.size);
+            // sources of one archive can't be read concurrently, so read them here
+            if (!job->read()) {
+                continue;
+            }
+
+            while (in_flight_size > 0 && in_flight_size + job->size > MAXIMUM_IN_FLIGHT_SIZE) {
+                jobs[first_in_flight]->future.wait();
+                in_flight_size -= jobs[first_in_flight]->size;
+                first_in_flight += 1;
+            }
+
+            in_flight_size += job->size;
+            job->future = pool.submit([job, spool, compression_level]() { job->compress(spool.get(), compression_level); });
+            jobs.push_back(job);
+        }
+    }
+
+    for (auto &job : jobs) {
+        job->future.wait();
+        if (!job->ok) {
+            continue;
+        }
+
+        auto user_data = new CompressedData(spool, *job, general_purpose_bit_flags(level));
+        auto original = (*job->source)->source;
+        zip_source_keep(original);
+        auto source = zip_source_layered_create(original, compressed_data_callback, user_data, nullptr);
+        if (source == nullptr) {
+            zip_source_free(original);
+            delete user_data;
+            continue;
+        }
+        *job->source = std::make_shared<ZipSource>(source);
+    }
+#endif
+}
+
+
+bool ZipCompressor::is_candidate(zip_source_t *source) {
+    zip_stat_t st;
+
+    zip_stat_init(&st);
+    if (zip_source_stat(source, &st) < 0) {
+        return false;
+    }
+
+    if ((st.valid & ZIP_STAT_SIZE) == 0 || st.size < MINIMUM_SIZE || st.size > MAXIMUM_SIZE) {
+        return false;
+    }
+    // already compressed data is copied as is
+    if ((st.valid & ZIP_STAT_COMP_METHOD) != 0 && st.comp_method != ZIP_CM_STORE) {
+        return false;
+    }
+
+    return true;
+}
+
+
+namespace {
+bool Spool::append(const std::vector<uint8_t> &data, uint64_t *offset) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    auto fd = fileno(file);
+    size_t done = 0;
+    while (done < data.size()) {
+        auto n = pwrite(fd, data.data() + done, data.size() - done, static_cast<off_t>(size + done));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+
+    *offset = size;
+    size += data.size();
+    return true;
+}
+
+
+bool Spool::read(uint64_t offset, void *data, size_t length) const {
+    auto fd = fileno(file);
+    size_t done = 0;
+    while (done < length) {
+        auto n = pread(fd, static_cast<uint8_t *>(data) + done, length - done, static_cast<off_t>(offset + done));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (n == 0) {
+            errno = EIO;
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+
+    return true;
+}
+
+
+bool Job::read() {
+    try {
+        (*source)->open();
+    }
+    catch (Exception &e) {
+        return false;
+    }
+
+    uint64_t done = 0;
+    try {
+        data.resize(size);
+        while (done < size) {
+            auto n = (*source)->read(data.data() + done, size - done);
+            if (n == 0) {
+                break;
+            }
+            done += n;
+        }
+    }
+    catch (Exception &e) {
+    }
+
+    try {
+        (*source)->close();
+    }
+    catch (Exception &e) {
+        done = 0;
+    }
+
+    if (done != size) {
+        data = {};
+        return false;
+    }
+
+    return true;
+}
+
+
+void Job::compress(Spool *spool, int level) {
+    // same parameters as libzip, so the output is identical
+    z_stream zstr = {};
+    if (deflateInit2(&zstr, level, Z_DEFLATED, -MAX_WBITS, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+        data = {};
+        return;
+    }
+
+    std::vector<uint8_t> compressed(deflateBound(&zstr, size));
+    zstr.next_in = data.data();
+    zstr.avail_in = static_cast<uInt>(size);
+    zstr.next_out = compressed.data();
+    zstr.avail_out = static_cast<uInt>(compressed.size());
+
+    auto ret = deflate(&zstr, Z_FINISH);
+    compressed_size = zstr.total_out;
+    deflateEnd(&zstr);
+
+    crc = static_cast<uint32_t>(crc32(crc32(0, nullptr, 0), data.data(), static_cast<uInt>(size)));
+    data = {};
+
+    if (ret != Z_STREAM_END) {
+        return;
+    }
+
+    compressed.resize(compressed_size);
+    ok = spool->append(compressed, &offset);
+}
+
+
+#ifdef HAVE_LAYERED_SOURCES
+zip_int64_t compressed_data_callback(zip_source_t *source, void *ud, void *data, zip_uint64_t length, zip_source_cmd_t command) {
+    auto compressed_data = static_cast<CompressedData *>(ud);
+
+    switch (command) {
+        case ZIP_SOURCE_OPEN:
+            compressed_data->position = 0;
+            return 0;
+
+        case ZIP_SOURCE_READ: {
+            auto n = std::min(length, compressed_data->compressed_size - compressed_data->position);
+            if (n > 0 && !compressed_data->spool->read(compressed_data->offset + compressed_data->position, data, n)) {
+                zip_error_set(&compressed_data->error, ZIP_ER_READ, errno);
+                return -1;
+            }
+            compressed_data->position += n;
+            return static_cast<zip_int64_t>(n);
+        }
+
+        case ZIP_SOURCE_CLOSE:
+            return 0;
+
+        case ZIP_SOURCE_STAT: {
+            if (length < sizeof(zip_stat_t)) {
+                zip_error_set(&compressed_data->error, ZIP_ER_INVAL, 0);
+                return -1;
+            }
+            auto st = static_cast<zip_stat_t *>(data);
+            st->size = compressed_data->size;
+            st->comp_size = compressed_data->compressed_size;
+            st->crc = compressed_data->crc;
+            st->comp_method = ZIP_CM_DEFLATE;
+            st->valid |= ZIP_STAT_SIZE | ZIP_STAT_COMP_SIZE | ZIP_STAT_CRC | ZIP_STAT_COMP_METHOD;
+            return 0;
+        }
+
+        case ZIP_SOURCE_GET_FILE_ATTRIBUTES: {
+            // what libzip's own compression reports
+            if (length < sizeof(zip_file_attributes_t)) {
+                zip_error_set(&compressed_data->error, ZIP_ER_INVAL, 0);
+                return -1;
+            }
+            auto attributes = static_cast<zip_file_attributes_t *>(data);
+            attributes->valid |= ZIP_FILE_ATTRIBUTES_VERSION_NEEDED | ZIP_FILE_ATTRIBUTES_GENERAL_PURPOSE_BIT_FLAGS;
+            attributes->version_needed = 20;
+            attributes->general_purpose_bit_mask = ZIP_FILE_ATTRIBUTES_GENERAL_PURPOSE_BIT_FLAGS_ALLOWED_MASK;
+            attributes->general_purpose_bit_flags = compressed_data->bit_flags;
+            return sizeof(*attributes);
+        }
+
+        case ZIP_SOURCE_ERROR:
+            return zip_error_to_data(&compressed_data->error, data, length);
+
+        case ZIP_SOURCE_FREE:
+            delete compressed_data;
+            return 0;
+
+        case ZIP_SOURCE_SUPPORTS:
+            return zip_source_make_command_bitmap(ZIP_SOURCE_OPEN, ZIP_SOURCE_READ, ZIP_SOURCE_CLOSE, ZIP_SOURCE_STAT, ZIP_SOURCE_GET_FILE_ATTRIBUTES, ZIP_SOURCE_ERROR, ZIP_SOURCE_FREE, -1);
+
+        default:
+            zip_error_set(&compressed_data->error, ZIP_ER_OPNOTSUPP, 0);
+            return -1;
+    }
+}
+#endif
+}
@@ -0,0 +1,65 @@
+#ifndef HAD_ZIP_COMPRESSOR_H
+#define HAD_ZIP_COMPRESSOR_H
+
+/*
+ZipCompressor.h -- compress files for zip archives in parallel
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "zip_util.h"
+
+// Compresses files to be added to a zip archive in parallel, before libzip writes the archive.
+// The compressed data is identical to what libzip would produce for the same compression level.
+class ZipCompressor {
+public:
+    ZipCompressor(size_t threads_, int level_) : threads(threads_), level(level_) { }
+
+    static bool is_supported();
+
+    // Replace sources worth compressing by sources of their compressed data, which libzip copies without recompressing.
+    void compress(const std::vector<ZipSourcePtr *> &sources) const;
+
+private:
+    static const uint64_t MINIMUM_SIZE;
+    static const uint64_t MAXIMUM_SIZE;
+    static const uint64_t MAXIMUM_IN_FLIGHT_SIZE;
+
+    size_t threads;
+    int level;
+
+    static bool is_candidate(zip_source_t *source);
+};
+
+#endif // HAD_ZIP_COMPRESSOR_H
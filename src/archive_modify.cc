@@ -39,6 +39,7 @@
 
 #include "CkmameDB.h"
 #include "Exception.h"
+#include "file_util.h"
 #include "MemDB.h"
 #include "CkmameCache.h"
 #include "globals.h"
@@ -216,12 +217,24 @@ bool Archive::file_copy_part(Archive *source_archive, uint64_t source_index, con
         add_file(filename, hashes, nullptr);
     }
 
-    if (have_direct_file_access() && source_archive->have_direct_file_access() && full_file) {
-        changes[files.size() - 1].file = source_archive->get_original_filename(source_index);
+    if (have_direct_file_access() && source_archive->have_direct_file_access() && (full_file || copy_file_part_supported())) {
+        auto &change = changes[files.size() - 1];
+        change.file = source_archive->get_original_filename(source_index);
+        if (!full_file) {
+            change.file_start = start;
+            change.file_length = length.has_value() ? length.value() : source_archive->files[source_index].hashes.size - start;
+        }
     }
     else {
         try {
-            changes[files.size() - 1].source = source_archive->get_source(source_index, start, length);
+            ZipSourcePtr source;
+            if (full_file && contents->archive_type == ARCHIVE_ZIP) {
+                source = source_archive->get_compressed_source(source_index);
+            }
+            if (!source) {
+                source = source_archive->get_source(source_index, start, length);
+            }
+            changes[files.size() - 1].source = source;
         }
         catch (Exception &ex) {
             files.pop_back();
@@ -321,6 +334,8 @@ bool Archive::rollback() {
             file.name = change.original_name;
         }
         change.file = "";
+        change.file_start = 0;
+        change.file_length = {};
         change.source = nullptr;
         
         switch (change.status) {
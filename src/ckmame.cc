@@ -34,6 +34,7 @@
 #include "CkMame.h"
 
 #include <algorithm>
+#include <cinttypes>
 #include <csignal>
 #include <cstring>
 #include <filesystem>
@@ -42,6 +43,7 @@
 #include "compat.h"
 #include "config.h"
 
+#include "ArchivePrefetcher.h"
 #include "check_util.h"
 #include "cleanup.h"
 #include "CkmameCache.h"
@@ -74,13 +76,16 @@ std::vector<Commandline::Option> ckmame_options = {
 std::unordered_set<std::string> ckmame_used_variables = {
     "complete_games_only",
     "complete_list",
+    "compression_level",
     "create_fixdat",
     "extra_directories",
     "fixdat_directory",
+    "jobs",
     "keep_old_duplicate",
     "missing_list",
     "move_from_extra",
     "old_db",
+    "prefetch_depth",
     "report_correct",
     "report_detailed",
     "report_fixable",
@@ -93,10 +98,12 @@ std::unordered_set<std::string> ckmame_used_variables = {
     "saved_directory",
     "unknown_directory",
     "update_database",
+    "use_directory_snapshot",
     "verbose"
 };
 
 static bool contains_romdir(const std::string &ame);
+static void print_debug_statistics();
 
 int main(int argc, char **argv) {
     auto command = CkMame();
@@ -172,6 +179,8 @@ bool CkMame::execute(const std::vector<std::string> &arguments) {
         return false;
     }
 
+    // Sets checked one after the other often share extra directories; read their caches only once.
+    CkmameCache::keep_for_next_set = multi_set_invocation;
     ckmame_cache = std::make_shared<CkmameCache>();
 
     try {
@@ -264,6 +273,10 @@ bool CkMame::execute(const std::vector<std::string> &arguments) {
         }
     }
 
+    // Interrupting stops at the next archive or game, so that cache databases are written.
+    signal(SIGINT, sighandle);
+    signal(SIGTERM, sighandle);
+
     MemDB::ensure();
 
     if (!ckmame_cache->superfluous_delete_list) {
@@ -355,6 +368,10 @@ bool CkMame::execute(const std::vector<std::string> &arguments) {
 
 
 bool CkMame::cleanup() {
+    if (getenv("CKMAME_DEBUG_STATISTICS")) {
+        print_debug_statistics();
+    }
+
     db = nullptr;
     old_db = nullptr;
     check_tree.clear();
@@ -365,6 +382,11 @@ bool CkMame::cleanup() {
 }
 
 
+bool CkMame::global_cleanup() {
+    return CkmameCache::release_kept();
+}
+
+
 static bool
 contains_romdir(const std::string &name) {
     std::error_code ec;
@@ -386,3 +408,21 @@ contains_romdir(const std::string &name) {
 
     return it_extra == normalized.end();
 }
+
+
+// internal counters, for tuning caches
+static void print_debug_statistics() {
+    if (db) {
+        fprintf(stderr, "game cache: %" PRIu64 " hits, %" PRIu64 " misses\n", db->game_cache.hits, db->game_cache.misses);
+    }
+    for (const auto &[name, romdb] : {std::make_pair("database", db.get()), std::make_pair("old database", old_db.get())}) {
+        if (romdb) {
+            const auto &filter = romdb->filter_statistics;
+            fprintf(stderr, "%s crc filter: %" PRIu64 " rejected, %" PRIu64 " passed, %" PRIu64 " of them unmatched\n", name, filter.rejected, filter.passed, filter.unmatched);
+        }
+    }
+    const auto &prefetch = ArchivePrefetcher::statistics;
+    if (prefetch.archives > 0) {
+        fprintf(stderr, "archive prefetch: %" PRIu64 " archives, blocked %" PRIu64 " of %" PRIu64 " times for %.3f seconds\n", prefetch.archives, prefetch.blocked, prefetch.waits, prefetch.blocked_seconds);
+    }
+}
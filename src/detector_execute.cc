@@ -33,24 +33,154 @@
 
 #include "Detector.h"
 
+#include <algorithm>
 #include <cstring>
 
+#include "Exception.h"
+#include "swap_accelerated.h"
+
 const uint64_t Detector::MAX_DETECTOR_FILE_SIZE = 128 * 1024 * 1024;
 
-static const uint8_t bitswap[] = {
-    0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0, 0x08, 0x88, 0x48, 0xC8, 0x28, 0xA8, 0x68, 0xE8, 0x18, 0x98, 0x58, 0xD8, 0x38, 0xB8, 0x78, 0xF8, 0x04, 0x84, 0x44, 0xC4, 0x24, 0xA4, 0x64, 0xE4, 0x14, 0x94, 0x54, 0xD4, 0x34, 0xB4, 0x74, 0xF4, 0x0C, 0x8C, 0x4C, 0xCC, 0x2C, 0xAC, 0x6C, 0xEC, 0x1C, 0x9C, 0x5C, 0xDC, 0x3C, 0xBC, 0x7C, 0xFC, 0x02, 0x82, 0x42, 0xC2, 0x22, 0xA2, 0x62, 0xE2, 0x12, 0x92, 0x52, 0xD2, 0x32, 0xB2, 0x72, 0xF2, 0x0A, 0x8A, 0x4A, 0xCA, 0x2A, 0xAA, 0x6A, 0xEA, 0x1A, 0x9A, 0x5A, 0xDA, 0x3A, 0xBA, 0x7A, 0xFA, 0x06, 0x86, 0x46, 0xC6, 0x26, 0xA6, 0x66, 0xE6, 0x16, 0x96, 0x56, 0xD6, 0x36, 0xB6, 0x76, 0xF6, 0x0E, 0x8E, 0x4E, 0xCE, 0x2E, 0xAE, 0x6E, 0xEE, 0x1E, 0x9E, 0x5E, 0xDE, 0x3E, 0xBE, 0x7E, 0xFE, 0x01, 0x81, 0x41, 0xC1, 0x21, 0xA1, 0x61, 0xE1, 0x11, 0x91, 0x51, 0xD1, 0x31, 0xB1, 0x71, 0xF1, 0x09, 0x89, 0x49, 0xC9, 0x29, 0xA9, 0x69, 0xE9, 0x19, 0x99, 0x59, 0xD9, 0x39, 0xB9, 0x79, 0xF9, 0x05, 0x85, 0x45, 0xC5, 0x25, 0xA5, 0x65, 0xE5, 0x15, 0x95, 0x55, 0xD5, 0x35, 0xB5, 0x75, 0xF5, 0x0D, 0x8D, 0x4D, 0xCD, 0x2D, 0xAD, 0x6D, 0xED, 0x1D, 0x9D, 0x5D, 0xDD, 0x3D, 0xBD, 0x7D, 0xFD, 0x03, 0x83, 0x43, 0xC3, 0x23, 0xA3, 0x63, 0xE3, 0x13, 0x93, 0x53, 0xD3, 0x33, 0xB3, 0x73, 0xF3, 0x0B, 0x8B, 0x4B, 0xCB, 0x2B, 0xAB, 0x6B, 0xEB, 0x1B, 0x9B, 0x5B, 0xDB, 0x3B, 0xBB, 0x7B, 0xFB, 0x07, 0x87, 0x47, 0xC7, 0x27, 0xA7, 0x67, 0xE7, 0x17, 0x97, 0x57, 0xD7, 0x37, 0xB7, 0x77, 0xF7, 0x0F, 0x8F, 0x4F, 0xCF, 0x2F, 0xAF, 0x6F, 0xEF, 0x1F, 0x9F, 0x5F, 0xDF, 0x3F, 0xBF, 0x7F, 0xFF
+#define BUFSIZE (64 * 1024)
+// Swapped data is hashed in blocks small enough to still be in the L1 cache.
+#define SWAP_BLOCK_SIZE (8 * 1024)
+
+// Hashes the data of one rule as it streams by.
+class Detector::RuleHasher {
+public:
+    RuleHasher(const Rule *rule, uint64_t start, uint64_t length);
+
+    const Rule *rule;
+    Hashes hashes;
+
+    void update(uint64_t offset, const uint8_t *data, uint64_t length);
+    void end();
+
+private:
+    uint64_t start;
+    uint64_t length;
+    uint64_t unit_size;
+    std::unique_ptr<Hashes::Update> hu;
+    std::vector<uint8_t> buffer;
+    uint8_t partial[4]; // unit split between two chunks
+    uint64_t partial_length;
 };
 
 
-Hashes Detector::execute(const std::vector<uint8_t> &data) const {
-    for (auto &rule : rules) {
-        auto hashes = rule.execute(data);
-        if (hashes.has_size()) {
-            return hashes;
+Detector::RuleHasher::RuleHasher(const Rule *rule_, uint64_t start_, uint64_t length_) : rule(rule_), start(start_), length(length_), unit_size(operation_unit_size(rule_->operation)), partial_length(0) {
+    hashes.add_types(Hashes::TYPE_ALL);
+    hashes.size = length;
+    hu = std::make_unique<Hashes::Update>(&hashes);
+    if (rule->operation != OP_NONE) {
+        buffer.resize(SWAP_BLOCK_SIZE);
+    }
+}
+
+
+void Detector::RuleHasher::update(uint64_t offset, const uint8_t *data, uint64_t data_length) {
+    if (offset + data_length <= start || offset >= start + length) {
+        return;
+    }
+    if (offset < start) {
+        data += start - offset;
+        data_length -= start - offset;
+        offset = start;
+    }
+    if (offset + data_length > start + length) {
+        data_length = start + length - offset;
+    }
+
+    if (rule->operation == OP_NONE) {
+        hu->update(data, data_length);
+        return;
+    }
+
+    if (partial_length > 0) {
+        auto n = std::min(unit_size - partial_length, data_length);
+        memcpy(partial + partial_length, data, n);
+        partial_length += n;
+        data += n;
+        data_length -= n;
+        if (partial_length < unit_size) {
+            return;
         }
+        apply_operation(rule->operation, buffer.data(), partial, unit_size);
+        hu->update(buffer.data(), unit_size);
+        partial_length = 0;
+    }
+
+    while (data_length >= unit_size) {
+        auto n = std::min(data_length - data_length % unit_size, static_cast<uint64_t>(buffer.size()));
+        apply_operation(rule->operation, buffer.data(), data, n);
+        hu->update(buffer.data(), n);
+        data += n;
+        data_length -= n;
     }
 
-    return {};
+    memcpy(partial, data, data_length);
+    partial_length = data_length;
+}
+
+
+void Detector::RuleHasher::end() {
+    hu->end();
+}
+
+
+void Detector::apply_operation(Operation operation, uint8_t *out, const uint8_t *in, size_t length) {
+    switch (operation) {
+        case OP_NONE:
+            memcpy(out, in, length);
+            break;
+
+        case OP_BITSWAP:
+            SwapAccelerated::bitswap(out, in, length);
+            break;
+
+        case OP_BYTESWAP:
+            SwapAccelerated::byteswap(out, in, length);
+            break;
+
+        case OP_WORDSWAP:
+            SwapAccelerated::wordswap(out, in, length);
+            break;
+    }
+}
+
+
+Detector::Sample::Sample(uint64_t size_, uint64_t head_size, uint64_t tail_size) : size(size_), head(std::min(head_size, size_)), tail_offset(size_ - std::min(tail_size, size_)), tail(size_ - tail_offset) {
+}
+
+
+void Detector::Sample::add(uint64_t offset, const uint8_t *data, uint64_t length) {
+    if (offset < head.size()) {
+        auto n = std::min(length, head.size() - offset);
+        memcpy(head.data() + offset, data, n);
+    }
+    if (offset + length > tail_offset) {
+        auto skip = tail_offset > offset ? tail_offset - offset : 0;
+        memcpy(tail.data() + (offset + skip - tail_offset), data + skip, length - skip);
+    }
+}
+
+
+const uint8_t *Detector::Sample::get(uint64_t offset, uint64_t length) const {
+    if (offset + length <= head.size()) {
+        return head.data() + offset;
+    }
+    if (offset >= tail_offset && offset + length <= size) {
+        return tail.data() + (offset - tail_offset);
+    }
+    return nullptr;
+}
+
+
+void Detector::update_sample_sizes(uint64_t *head_size, uint64_t *tail_size) const {
+    for (auto &rule : rules) {
+        for (auto &test : rule.tests) {
+            test.update_sample_sizes(head_size, tail_size);
+        }
+    }
 }
 
 
@@ -86,84 +216,83 @@ bool Detector::Test::bit_cmp(const uint8_t *b) const {
 }
 
 
-Hashes Detector::Rule::compute_values(Operation operation, const std::vector<uint8_t> &data, uint64_t start, uint64_t length) const {
-    Hashes hashes;
-    
-    hashes.add_types(Hashes::TYPE_ALL);
-    Hashes::Update hu(&hashes);
-    
-    if (operation == OP_NONE) {
-        hu.update(data.data() + start, length);
-    }
-    else {
-        auto processed_data = std::vector<uint8_t>(length);
-
-        switch (operation) {
-        case OP_NONE:
-            // can't happen
-            break;
-        
-        case OP_BITSWAP:
-            for (size_t i = 0; i < length; i++) {
-                processed_data[i] = bitswap[data[start + i]];
-            }
-            break;
-                
-        case OP_BYTESWAP:
-            for (size_t i = 0; i < length; i += 2) {
-                processed_data[i] = data[start + i + 1];
-                processed_data[i + 1] = data[start + i];
-            }
-            break;
-
-        case OP_WORDSWAP:
-            for (size_t i = 0; i < length; i += 4) {
-                processed_data[i] = data[start + i + 3];
-                processed_data[i + 1] = data[start + i + 2];
-                processed_data[i + 2] = data[start + i + 1];
-                processed_data[i + 3] = data[start + i];
-            }
-        }
-        
-        hu.update(processed_data.data(), length);
-    }
-    
-    hu.end();
-    
-    hashes.size = length;
-    return hashes;
-}
-
-
-
-Hashes Detector::Rule::execute(const std::vector<uint8_t> &data) const {
+bool Detector::Rule::get_range(uint64_t size, uint64_t *start_ret, uint64_t *length_ret) const {
     auto start = start_offset;
     if (start < 0) {
-        start += static_cast<int64_t>(data.size());
+        start += static_cast<int64_t>(size);
     }
     auto end = end_offset;
     if (end == DETECTOR_OFFSET_EOF) {
-        end = static_cast<int64_t>(data.size());
+        end = static_cast<int64_t>(size);
     }
     else if (end < 0) {
-        end += static_cast<int64_t>(data.size());
+        end += static_cast<int64_t>(size);
     }
     
-    if (start < 0 || static_cast<uint64_t>(start) > data.size() || end < 0 || static_cast<uint64_t>(end) > data.size() || start > end || static_cast<uint64_t>(end - start) % operation_unit_size(operation) != 0) {
-        return {};
+    if (start < 0 || static_cast<uint64_t>(start) > size || end < 0 || static_cast<uint64_t>(end) > size || start > end || static_cast<uint64_t>(end - start) % operation_unit_size(operation) != 0) {
+        return false;
     }
 
+    *start_ret = static_cast<uint64_t>(start);
+    *length_ret = static_cast<uint64_t>(end - start);
+    return true;
+}
+
+
+bool Detector::Rule::matches(const Sample &sample, bool have_tail) const {
     for (auto &test : tests) {
-        if (!test.execute(data)) {
-            return {};
+        if (!have_tail && test.needs_tail()) {
+            continue;
+        }
+        if (!test.execute(sample)) {
+            return false;
         }
     }
 
-    return compute_values(operation, data, static_cast<uint64_t>(start), static_cast<uint64_t>(end - start));
+    return true;
+}
+
+
+bool Detector::Rule::needs_tail() const {
+    return std::any_of(tests.begin(), tests.end(), [](const Test &test) { return test.needs_tail(); });
+}
+
+
+bool Detector::Test::needs_tail() const {
+    switch (type) {
+        case TEST_DATA:
+        case TEST_OR:
+        case TEST_AND:
+        case TEST_XOR:
+            return offset < 0;
+
+        default:
+            return false;
+    }
 }
 
 
-bool Detector::Test::execute(const std::vector<uint8_t> &data) const {
+void Detector::Test::update_sample_sizes(uint64_t *head_size, uint64_t *tail_size) const {
+    switch (type) {
+        case TEST_DATA:
+        case TEST_OR:
+        case TEST_AND:
+        case TEST_XOR:
+            if (offset < 0) {
+                *tail_size = std::max(*tail_size, static_cast<uint64_t>(-offset));
+            }
+            else {
+                *head_size = std::max(*head_size, static_cast<uint64_t>(offset) + length);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+bool Detector::Test::execute(const Sample &sample) const {
     auto match = false;
     
     switch (type) {
@@ -174,18 +303,23 @@ bool Detector::Test::execute(const std::vector<uint8_t> &data) const {
             auto off = offset;
             
             if (off < 0) {
-                off += data.size();
+                off += sample.size;
             }
             
-            if (off < 0 || static_cast<uint64_t>(off) + length < static_cast<uint64_t>(off) || static_cast<uint64_t>(off) + length > data.size()) {
+            if (off < 0 || static_cast<uint64_t>(off) + length < static_cast<uint64_t>(off) || static_cast<uint64_t>(off) + length > sample.size) {
+                return false;
+            }
+
+            auto data = sample.get(static_cast<uint64_t>(off), length);
+            if (data == nullptr) {
                 return false;
             }
             
             if (mask.empty()) {
-                match = (memcmp(data.data() + off, value.data(), length) == 0);
+                match = (memcmp(data, value.data(), length) == 0);
             }
             else {
-                match = bit_cmp(data.data() + off);
+                match = bit_cmp(data);
             }
             break;
         }
@@ -196,14 +330,14 @@ bool Detector::Test::execute(const std::vector<uint8_t> &data) const {
             if (offset == DETECTOR_SIZE_POWER_OF_2) {
                 match = false;
                 for (auto i = 0; i < 64; i++) {
-                    if (data.size() == (static_cast<uint64_t>(1) << i)) {
+                    if (sample.size == (static_cast<uint64_t>(1) << i)) {
                         match = true;
                         break;
                     }
                 }
             }
             else {
-                int64_t cmp = offset - static_cast<int64_t>(data.size());
+                int64_t cmp = offset - static_cast<int64_t>(sample.size);
                 
                 switch (type) {
                     case TEST_FILE_EQ:
@@ -231,13 +365,95 @@ bool Detector::Test::execute(const std::vector<uint8_t> &data) const {
 }
 
 
-bool Detector::compute_hashes(const std::vector<uint8_t> &data, File *file, const std::unordered_map<size_t, DetectorPtr> &detectors) {
-    if (file->get_size(0) > MAX_DETECTOR_FILE_SIZE) {
+bool Detector::compute_hashes(const ZipSource *source, File *file, const std::unordered_map<size_t, DetectorPtr> &detectors) {
+    auto size = file->get_size(0);
+
+    if (size > MAX_DETECTOR_FILE_SIZE) {
         return false;
     }
-    
+
+    uint64_t head_size = 0;
+    uint64_t tail_size = 0;
     for (const auto &pair : detectors) {
-        file->detector_hashes[pair.first] = pair.second->execute(data);
+        pair.second->update_sample_sizes(&head_size, &tail_size);
+    }
+
+    auto sample = Sample(size, head_size, tail_size);
+    auto buffer = std::vector<uint8_t>(BUFSIZE);
+    uint64_t offset = 0;
+
+    auto read = [&](uint64_t length) {
+        length = std::min(length, size - offset);
+        uint64_t done = 0;
+        while (done < length) {
+            auto n = source->read(buffer.data() + done, length - done);
+            if (n == 0) {
+                throw Exception("unexpected end of file");
+            }
+            done += n;
+        }
+        sample.add(offset, buffer.data(), length);
+        return length;
+    };
+
+    // Read the head before anything else, so rules whose tests fail on it are not hashed at all.
+    while (offset < sample.get_head_size()) {
+        offset += read(std::min(static_cast<uint64_t>(BUFSIZE), sample.get_head_size() - offset));
+    }
+
+    // Rules that may match, for each detector in order. A rule that doesn't look at the end of the file hides all later rules.
+    std::unordered_map<size_t, std::vector<std::unique_ptr<RuleHasher>>> candidates;
+    for (const auto &pair : detectors) {
+        auto &hashers = candidates[pair.first];
+        for (const auto &rule : pair.second->rules) {
+            uint64_t start, length;
+            if (!rule.get_range(size, &start, &length) || !rule.matches(sample, false)) {
+                continue;
+            }
+            hashers.push_back(std::make_unique<RuleHasher>(&rule, start, length));
+            if (!rule.needs_tail()) {
+                break;
+            }
+        }
+    }
+
+    // No rule can match, so there is nothing to hash and the rest of the file is not needed.
+    if (std::all_of(candidates.begin(), candidates.end(), [](const auto &pair) { return pair.second.empty(); })) {
+        for (const auto &pair : detectors) {
+            file->detector_hashes[pair.first] = Hashes();
+        }
+        return true;
+    }
+
+    auto update = [&](uint64_t chunk_offset, const uint8_t *data, uint64_t length) {
+        for (auto &pair : candidates) {
+            for (auto &hasher : pair.second) {
+                hasher->update(chunk_offset, data, length);
+            }
+        }
+    };
+
+    // The head has been read in chunks of BUFSIZE too, but only the last one is still in buffer.
+    for (uint64_t head_offset = 0; head_offset < sample.get_head_size(); head_offset += BUFSIZE) {
+        auto length = std::min(static_cast<uint64_t>(BUFSIZE), sample.get_head_size() - head_offset);
+        update(head_offset, sample.get(head_offset, length), length);
+    }
+    while (offset < size) {
+        auto length = read(BUFSIZE);
+        update(offset, buffer.data(), length);
+        offset += length;
+    }
+
+    for (const auto &pair : detectors) {
+        Hashes hashes;
+        for (auto &hasher : candidates[pair.first]) {
+            if (hasher->rule->matches(sample, true)) {
+                hasher->end();
+                hashes = hasher->hashes;
+                break;
+            }
+        }
+        file->detector_hashes[pair.first] = hashes;
     }
     
     return true;
@@ -33,20 +33,249 @@
 
 #include "file_util.h"
 
+#include "config.h"
+
+#include <algorithm>
+#include <cerrno>
 #include <filesystem>
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HAVE_SENDFILE
+#include <sys/sendfile.h>
+#endif
+#ifdef HAVE_FICLONE
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
 #include "Exception.h"
 #include "globals.h"
 
+namespace {
+class FileDescriptor {
+public:
+    explicit FileDescriptor(int fd_) : fd(fd_) { }
+    ~FileDescriptor() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    int fd;
+};
+
+enum CopyResult {
+    COPY_DONE,
+    COPY_UNSUPPORTED,
+    COPY_ERROR
+};
+
+// Each method copies as much as it can and updates offset and remaining.
+// COPY_UNSUPPORTED means the next method should continue from there.
+
+CopyResult copy_clone(int fin, int fout, uint64_t size, uint64_t *offset, uint64_t *remaining) {
+#ifdef HAVE_FICLONE
+    if (*offset == 0 && *remaining == size) {
+        if (ioctl(fout, FICLONE, fin) == 0) {
+            *remaining = 0;
+            return COPY_DONE;
+        }
+    }
+    else {
+        // only works for ranges aligned to the file system block size or ending at end of file
+        struct file_clone_range range = {};
+        range.src_fd = fin;
+        range.src_offset = *offset;
+        range.src_length = *remaining;
+        range.dest_offset = 0;
+        if (ioctl(fout, FICLONERANGE, &range) == 0) {
+            *remaining = 0;
+            return COPY_DONE;
+        }
+    }
+#endif
+    return COPY_UNSUPPORTED;
+}
+
+
+CopyResult copy_in_kernel(int fin, int fout, uint64_t *offset, uint64_t *remaining) {
+#ifdef HAVE_COPY_FILE_RANGE
+    while (*remaining > 0) {
+        auto in_offset = static_cast<off_t>(*offset);
+        auto n = copy_file_range(fin, &in_offset, fout, nullptr, std::min(*remaining, static_cast<uint64_t>(1024 * 1024 * 1024)), 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP || errno == EBADF) {
+                return COPY_UNSUPPORTED;
+            }
+            return COPY_ERROR;
+        }
+        if (n == 0) {
+            // some file systems don't report data, let the other methods detect real end of file
+            return COPY_UNSUPPORTED;
+        }
+        *offset += static_cast<uint64_t>(n);
+        *remaining -= static_cast<uint64_t>(n);
+    }
+    return COPY_DONE;
+#else
+    return COPY_UNSUPPORTED;
+#endif
+}
+
+
+CopyResult copy_sendfile(int fin, int fout, uint64_t *offset, uint64_t *remaining) {
+#ifdef HAVE_SENDFILE
+    while (*remaining > 0) {
+        auto in_offset = static_cast<off_t>(*offset);
+        auto n = sendfile(fout, fin, &in_offset, std::min(*remaining, static_cast<uint64_t>(1024 * 1024 * 1024)));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP) {
+                return COPY_UNSUPPORTED;
+            }
+            return COPY_ERROR;
+        }
+        if (n == 0) {
+            return COPY_UNSUPPORTED;
+        }
+        *offset += static_cast<uint64_t>(n);
+        *remaining -= static_cast<uint64_t>(n);
+    }
+    return COPY_DONE;
+#else
+    return COPY_UNSUPPORTED;
+#endif
+}
+
+
+CopyResult copy_userspace(int fin, int fout, uint64_t *offset, uint64_t *remaining) {
+#ifdef HAVE_PREAD
+    unsigned char buffer[64 * 1024];
+
+    while (*remaining > 0) {
+        auto n = pread(fin, buffer, static_cast<size_t>(std::min(*remaining, static_cast<uint64_t>(sizeof(buffer)))), static_cast<off_t>(*offset));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return COPY_ERROR;
+        }
+        if (n == 0) {
+            errno = EIO;
+            return COPY_ERROR;
+        }
+        for (ssize_t done = 0; done < n;) {
+            auto written = write(fout, buffer + done, static_cast<size_t>(n - done));
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return COPY_ERROR;
+            }
+            done += written;
+        }
+        *offset += static_cast<uint64_t>(n);
+        *remaining -= static_cast<uint64_t>(n);
+    }
+    return COPY_DONE;
+#else
+    return COPY_UNSUPPORTED;
+#endif
+}
+}
+
+
+bool copy_file_contents(const std::string &old, const std::string &new_name, uint64_t start, std::optional<uint64_t> length, bool overwrite) {
+    FileDescriptor fin(open(old.c_str(), O_RDONLY));
+    if (fin.fd < 0) {
+        output.error_system("cannot open '%s'", old.c_str());
+        return false;
+    }
+
+    struct stat st = {};
+    if (fstat(fin.fd, &st) < 0) {
+        output.error_system("cannot stat '%s'", old.c_str());
+        return false;
+    }
+    auto size = static_cast<uint64_t>(st.st_size);
+    if (start > size || (length.has_value() && length.value() > size - start)) {
+        errno = EINVAL;
+        output.error_system("cannot copy '%s' to '%s'", old.c_str(), new_name.c_str());
+        return false;
+    }
+
+    FileDescriptor fout(open(new_name.c_str(), O_WRONLY | O_CREAT | (overwrite ? O_TRUNC : O_EXCL), st.st_mode & 0777));
+    if (fout.fd < 0) {
+        output.error_system("cannot create '%s'", new_name.c_str());
+        return false;
+    }
+
+    auto offset = start;
+    auto remaining = length.has_value() ? length.value() : size - start;
+
+    auto result = copy_clone(fin.fd, fout.fd, size, &offset, &remaining);
+    if (result == COPY_UNSUPPORTED) {
+        result = copy_in_kernel(fin.fd, fout.fd, &offset, &remaining);
+    }
+    if (result == COPY_UNSUPPORTED) {
+        result = copy_sendfile(fin.fd, fout.fd, &offset, &remaining);
+    }
+    if (result == COPY_UNSUPPORTED) {
+        result = copy_userspace(fin.fd, fout.fd, &offset, &remaining);
+    }
+
+    auto error = result == COPY_DONE ? 0 : errno;
+    if (close(fout.fd) < 0 && error == 0) {
+        error = errno;
+    }
+    fout.fd = -1;
+
+    if (result == COPY_UNSUPPORTED) {
+        // last resort, only possible if nothing was copied yet
+        if (offset == 0 && remaining == size) {
+            std::error_code ec;
+            std::filesystem::copy_file(old, new_name, std::filesystem::copy_options::overwrite_existing, ec);
+            error = ec ? ec.value() : 0;
+        }
+        else {
+            error = ENOTSUP;
+        }
+    }
+
+    if (error != 0) {
+        std::error_code ec;
+        std::filesystem::remove(new_name, ec);
+        errno = error;
+        output.error_system("cannot copy '%s' to '%s'", old.c_str(), new_name.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+
+bool copy_file_part_supported() {
+#ifdef HAVE_PREAD
+    return true;
+#else
+    return false;
+#endif
+}
+
+
 bool
 link_or_copy(const std::string &old, const std::string &new_name) {
     std::error_code ec;
     std::filesystem::create_hard_link(old, new_name, ec);
     if (ec) {
-	if (!std::filesystem::copy_file(old, new_name, ec) || ec) {
-	    output.error_error_code(ec, "cannot copy '%s' to '%s'", old.c_str(), new_name.c_str());
-	    return false;
-	}
+        return copy_file_contents(old, new_name);
     }
 
     return true;
@@ -70,9 +299,7 @@ bool rename_or_move(const std::string &old, const std::string &new_name) {
     std::error_code ec;
     std::filesystem::rename(old, new_name, ec);
     if (ec) {
-        std::filesystem::copy_file(old, new_name, std::filesystem::copy_options::overwrite_existing, ec);
-        if (ec) {
-	    output.error_error_code(ec, "cannot rename '%s' to '%s'", old.c_str(), new_name.c_str());
+        if (!copy_file_contents(old, new_name, 0, {}, true)) {
 	    return false;
 	}
 	std::filesystem::remove(old);
@@ -35,8 +35,13 @@
 */
 
 #include <filesystem>
+#include <optional>
 #include <string>
 
+// Copy (part of) file, cloning or copying in kernel where possible.
+bool copy_file_contents(const std::string &old, const std::string &new_name, uint64_t start = 0, std::optional<uint64_t> length = {}, bool overwrite = false);
+// Whether copy_file_contents() can always copy part of a file.
+bool copy_file_part_supported();
 bool link_or_copy(const std::string &old, const std::string &new_name);
 bool my_remove(const std::string &name);
 bool rename_or_move(const std::string &old, const std::string &new_name);
@@ -0,0 +1,651 @@
+/*
+hashes_accelerated.cc -- hardware accelerated hash functions
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "hashes_accelerated.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <climits>
+#include <cstring>
+
+extern "C" {
+#include <zlib.h>
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_ACCELERATION
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+#define HAVE_ARM_ACCELERATION
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#endif
+
+// Multi-buffer MD5 uses the vector extensions of GCC and Clang.
+#if defined(__GNUC__)
+#define HAVE_MULTI_BUFFER_MD5
+#else
+#include "config.h"
+
+#ifdef HAVE_MD5INIT
+extern "C" {
+#include <md5.h>
+}
+#else
+#include "md5_own.h"
+#endif
+#endif
+
+bool HashesAccelerated::enabled = true;
+
+namespace {
+class CpuFeatures {
+public:
+    CpuFeatures();
+
+    bool avx2;
+    bool crc32;
+    bool sha1;
+};
+
+CpuFeatures::CpuFeatures() : avx2(false), crc32(false), sha1(false) {
+    if (getenv("CKMAME_NO_ACCELERATED_HASHES") != nullptr) {
+        return;
+    }
+#if defined(HAVE_X86_ACCELERATION)
+    unsigned int eax, ebx, ecx, edx;
+
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0) {
+        return;
+    }
+    auto ssse3 = (ecx & bit_SSSE3) != 0;
+    auto sse41 = (ecx & bit_SSE4_1) != 0;
+    auto pclmul = (ecx & bit_PCLMUL) != 0;
+
+    crc32 = sse41 && pclmul;
+
+    auto osxsave = (ecx & bit_OSXSAVE) != 0;
+
+    auto os_saves_avx = false;
+    if (osxsave) {
+        // AVX state must be enabled by the operating system
+        unsigned int xcr0_low, xcr0_high;
+        __asm__("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+        os_saves_avx = (xcr0_low & 0x6) == 0x6;
+    }
+
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) != 0) {
+        sha1 = ssse3 && sse41 && (ebx & bit_SHA) != 0;
+        avx2 = os_saves_avx && (ebx & bit_AVX2) != 0;
+    }
+#elif defined(HAVE_ARM_ACCELERATION)
+    crc32 = (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#endif
+}
+
+const CpuFeatures &cpu_features() {
+    static const CpuFeatures features;
+    return features;
+}
+
+#if defined(HAVE_X86_ACCELERATION)
+// Folding CRC32 as described in "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction" (Intel, 2009).
+// length must be at least 64 and a multiple of 16, crc is not inverted.
+__attribute__((target("pclmul,sse4.1"))) uint32_t crc32_pclmul(uint32_t crc, const uint8_t *data, size_t length) {
+    alignas(16) static const uint64_t k1k2[] = {0x0154442bd4, 0x01c6e41596};
+    alignas(16) static const uint64_t k3k4[] = {0x01751997d0, 0x00ccaa009e};
+    alignas(16) static const uint64_t k5k0[] = {0x0163cd6124, 0x0000000000};
+    alignas(16) static const uint64_t poly[] = {0x01db710641, 0x01f7011641};
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x00));
+    x2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x10));
+    x3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x20));
+    x4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x30));
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i *>(k1k2));
+
+    data += 64;
+    length -= 64;
+
+    // fold 4 x 128 bits in parallel
+    while (length >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x00));
+        y6 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x10));
+        y7 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x20));
+        y8 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        data += 64;
+        length -= 64;
+    }
+
+    // fold into 128 bits
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i *>(k3k4));
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // fold remaining 128 bit blocks
+    while (length >= 16) {
+        x2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        data += 16;
+        length -= 16;
+    }
+
+    // fold 128 bits to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(k5k0));
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i *>(poly));
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+
+__attribute__((target("sha,ssse3,sse4.1"))) void sha1_shani(uint32_t *state, const uint8_t *data, size_t blocks) {
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+    auto abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state)), 0x1b);
+    auto e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+    __m128i e1;
+    __m128i msg[4];
+
+// RNDS4 needs the round function selector as immediate, so the 20 groups of 4 rounds are spelled out.
+#define SHA1_ROUNDS(g, f) \
+    do { \
+        if ((g) < 4) { \
+            msg[(g) % 4] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * ((g) % 4))), mask); \
+        } \
+        if ((g) % 2 == 0) { \
+            e0 = (g) == 0 ? _mm_add_epi32(e0, msg[0]) : _mm_sha1nexte_epu32(e0, msg[(g) % 4]); \
+            e1 = abcd; \
+            abcd = _mm_sha1rnds4_epu32(abcd, e0, f); \
+        } \
+        else { \
+            e1 = _mm_sha1nexte_epu32(e1, msg[(g) % 4]); \
+            e0 = abcd; \
+            abcd = _mm_sha1rnds4_epu32(abcd, e1, f); \
+        } \
+        if ((g) >= 3 && (g) <= 18) { \
+            msg[((g) + 1) % 4] = _mm_sha1msg2_epu32(msg[((g) + 1) % 4], msg[(g) % 4]); \
+        } \
+        if ((g) >= 2 && (g) <= 17) { \
+            msg[((g) + 2) % 4] = _mm_xor_si128(msg[((g) + 2) % 4], msg[(g) % 4]); \
+        } \
+        if ((g) >= 1 && (g) <= 16) { \
+            msg[((g) + 3) % 4] = _mm_sha1msg1_epu32(msg[((g) + 3) % 4], msg[(g) % 4]); \
+        } \
+    } while (0)
+
+    while (blocks-- > 0) {
+        auto abcd_save = abcd;
+        auto e0_save = e0;
+
+        SHA1_ROUNDS(0, 0); SHA1_ROUNDS(1, 0); SHA1_ROUNDS(2, 0); SHA1_ROUNDS(3, 0); SHA1_ROUNDS(4, 0);
+        SHA1_ROUNDS(5, 1); SHA1_ROUNDS(6, 1); SHA1_ROUNDS(7, 1); SHA1_ROUNDS(8, 1); SHA1_ROUNDS(9, 1);
+        SHA1_ROUNDS(10, 2); SHA1_ROUNDS(11, 2); SHA1_ROUNDS(12, 2); SHA1_ROUNDS(13, 2); SHA1_ROUNDS(14, 2);
+        SHA1_ROUNDS(15, 3); SHA1_ROUNDS(16, 3); SHA1_ROUNDS(17, 3); SHA1_ROUNDS(18, 3); SHA1_ROUNDS(19, 3);
+
+        e0 = _mm_sha1nexte_epu32(e0, e0_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+
+        data += 64;
+    }
+
+#undef SHA1_ROUNDS
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(state), _mm_shuffle_epi32(abcd, 0x1b));
+    state[4] = static_cast<uint32_t>(_mm_extract_epi32(e0, 3));
+}
+#endif
+
+
+#if defined(HAVE_MULTI_BUFFER_MD5)
+// Multi-buffer MD5: each lane of the vector type V computes the MD5 of a different input.
+typedef uint32_t Md5Vector4 __attribute__((vector_size(16)));
+#if defined(HAVE_X86_ACCELERATION)
+typedef uint32_t Md5Vector8 __attribute__((vector_size(32)));
+#endif
+
+const uint32_t md5_constants[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+const int md5_shifts[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+template <typename V, size_t L> class Md5Lanes {
+public:
+    explicit Md5Lanes(const std::vector<HashesAccelerated::Md5Job> &jobs_) : jobs(jobs_), next_job(0) { }
+
+    __attribute__((always_inline)) inline void run();
+
+private:
+    class Lane {
+    public:
+        Lane() : job(nullptr), data(nullptr), blocks(0), in_tail(false), tail{} { }
+
+        const HashesAccelerated::Md5Job *job;
+        const uint8_t *data;
+        size_t blocks;
+        bool in_tail;
+        uint8_t tail[128];
+    };
+
+    const std::vector<HashesAccelerated::Md5Job> &jobs;
+    size_t next_job;
+    Lane lanes[L];
+    V a, b, c, d;
+
+    void assign(size_t lane);
+    void start_tail(size_t lane);
+    void finish(size_t lane);
+    __attribute__((always_inline)) inline void process(size_t blocks);
+};
+
+template <typename V, size_t L> void Md5Lanes<V, L>::assign(size_t index) {
+    auto &lane = lanes[index];
+
+    if (next_job >= jobs.size()) {
+        lane.job = nullptr;
+        return;
+    }
+
+    lane.job = &jobs[next_job++];
+    lane.data = lane.job->data;
+    lane.blocks = lane.job->length / 64;
+    lane.in_tail = false;
+    a[index] = 0x67452301;
+    b[index] = 0xefcdab89;
+    c[index] = 0x98badcfe;
+    d[index] = 0x10325476;
+
+    if (lane.blocks == 0) {
+        start_tail(index);
+    }
+}
+
+template <typename V, size_t L> void Md5Lanes<V, L>::start_tail(size_t index) {
+    auto &lane = lanes[index];
+    auto rest = lane.job->length % 64;
+    uint64_t bits = static_cast<uint64_t>(lane.job->length) * 8;
+
+    memset(lane.tail, 0, sizeof(lane.tail));
+    memcpy(lane.tail, lane.job->data + lane.job->length - rest, rest);
+    lane.tail[rest] = 0x80;
+    lane.blocks = rest < 56 ? 1 : 2;
+    for (size_t i = 0; i < 8; i++) {
+        lane.tail[lane.blocks * 64 - 8 + i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+    lane.data = lane.tail;
+    lane.in_tail = true;
+}
+
+template <typename V, size_t L> void Md5Lanes<V, L>::finish(size_t index) {
+    uint32_t state[4] = {a[index], b[index], c[index], d[index]};
+
+    for (size_t i = 0; i < 4; i++) {
+        for (size_t j = 0; j < 4; j++) {
+            lanes[index].job->digest[4 * i + j] = static_cast<uint8_t>(state[i] >> (8 * j));
+        }
+    }
+}
+
+template <typename V, size_t L> void Md5Lanes<V, L>::run() {
+    for (size_t index = 0; index < L; index++) {
+        assign(index);
+    }
+
+    while (true) {
+        size_t blocks = SIZE_MAX;
+        for (auto &lane : lanes) {
+            if (lane.job != nullptr) {
+                blocks = std::min(blocks, lane.blocks);
+            }
+        }
+        if (blocks == SIZE_MAX) {
+            break;
+        }
+
+        process(blocks);
+
+        for (size_t index = 0; index < L; index++) {
+            auto &lane = lanes[index];
+            if (lane.job == nullptr) {
+                continue;
+            }
+            lane.blocks -= blocks;
+            lane.data += blocks * 64;
+            if (lane.blocks == 0) {
+                if (lane.in_tail) {
+                    finish(index);
+                    assign(index);
+                }
+                else {
+                    start_tail(index);
+                }
+            }
+        }
+    }
+}
+
+template <typename V, size_t L> void Md5Lanes<V, L>::process(size_t blocks) {
+    static const uint8_t idle_block[64] = {};
+
+    for (size_t block = 0; block < blocks; block++) {
+        V x[16];
+        for (size_t index = 0; index < L; index++) {
+            auto data = lanes[index].job != nullptr ? lanes[index].data + block * 64 : idle_block;
+            for (size_t k = 0; k < 16; k++) {
+                x[k][index] = static_cast<uint32_t>(data[4 * k]) | static_cast<uint32_t>(data[4 * k + 1]) << 8 | static_cast<uint32_t>(data[4 * k + 2]) << 16 | static_cast<uint32_t>(data[4 * k + 3]) << 24;
+            }
+        }
+
+        auto aa = a, bb = b, cc = c, dd = d;
+
+        for (size_t i = 0; i < 64; i++) {
+            V f;
+            size_t k;
+            if (i < 16) {
+                f = dd ^ (bb & (cc ^ dd));
+                k = i;
+            }
+            else if (i < 32) {
+                f = cc ^ (dd & (bb ^ cc));
+                k = (5 * i + 1) % 16;
+            }
+            else if (i < 48) {
+                f = bb ^ cc ^ dd;
+                k = (3 * i + 5) % 16;
+            }
+            else {
+                f = cc ^ (bb | ~dd);
+                k = (7 * i) % 16;
+            }
+            auto t = aa + f + x[k] + md5_constants[i];
+            aa = dd;
+            dd = cc;
+            cc = bb;
+            bb = bb + ((t << md5_shifts[i]) | (t >> (32 - md5_shifts[i])));
+        }
+
+        a += aa;
+        b += bb;
+        c += cc;
+        d += dd;
+    }
+}
+
+void md5_multi_4(const std::vector<HashesAccelerated::Md5Job> &jobs) {
+    Md5Lanes<Md5Vector4, 4>(jobs).run();
+}
+#else
+void md5_multi_4(const std::vector<HashesAccelerated::Md5Job> &jobs) {
+    for (const auto &job : jobs) {
+        MD5_CTX context;
+        MD5Init(&context);
+        MD5Update(&context, job.data, static_cast<unsigned int>(job.length));
+        MD5Final(job.digest, &context);
+    }
+}
+#endif
+
+#if defined(HAVE_X86_ACCELERATION)
+__attribute__((target("avx2"))) void md5_multi_8(const std::vector<HashesAccelerated::Md5Job> &jobs) {
+    Md5Lanes<Md5Vector8, 8>(jobs).run();
+}
+#endif
+
+#if defined(HAVE_ARM_ACCELERATION)
+__attribute__((target("+crc"))) uint32_t crc32_arm(uint32_t crc, const uint8_t *data, size_t length) {
+    crc = ~crc;
+
+    while (length >= 8) {
+        uint64_t value;
+        memcpy(&value, data, 8);
+        crc = __crc32d(crc, value);
+        data += 8;
+        length -= 8;
+    }
+    while (length > 0) {
+        crc = __crc32b(crc, *data);
+        data += 1;
+        length -= 1;
+    }
+
+    return ~crc;
+}
+#endif
+} // namespace
+
+
+bool HashesAccelerated::have_crc32() {
+    return enabled && cpu_features().crc32;
+}
+
+
+bool HashesAccelerated::have_sha1() {
+    return enabled && cpu_features().sha1;
+}
+
+
+size_t HashesAccelerated::md5_lanes() {
+    if (!enabled) {
+        return 0;
+    }
+#if defined(HAVE_X86_ACCELERATION)
+    return cpu_features().avx2 ? 8 : 4;
+#elif defined(HAVE_ARM_ACCELERATION)
+    return 4;
+#else
+    return 0;
+#endif
+}
+
+
+void HashesAccelerated::md5_multi(const std::vector<Md5Job> &jobs) {
+#if defined(HAVE_X86_ACCELERATION)
+    if (cpu_features().avx2) {
+        md5_multi_8(jobs);
+        return;
+    }
+#endif
+    md5_multi_4(jobs);
+}
+
+
+std::string HashesAccelerated::description() {
+    std::string crc32_name = "zlib";
+    std::string sha1_name = "portable";
+
+#if defined(HAVE_X86_ACCELERATION)
+    if (have_crc32()) {
+        crc32_name = "pclmul";
+    }
+    if (have_sha1()) {
+        sha1_name = "sha-ni";
+    }
+#elif defined(HAVE_ARM_ACCELERATION)
+    if (have_crc32()) {
+        crc32_name = "armv8-crc";
+    }
+#endif
+
+    auto md5_name = md5_lanes() > 0 ? "portable (" + std::to_string(md5_lanes()) + " lanes for batches)" : std::string("portable");
+
+    return "crc: " + crc32_name + ", md5: " + md5_name + ", sha1: " + sha1_name;
+}
+
+
+uint32_t HashesAccelerated::crc32(uint32_t crc, const uint8_t *data, size_t length) {
+#if defined(HAVE_X86_ACCELERATION)
+    if (length >= 64) {
+        auto chunk = length & ~static_cast<size_t>(15);
+        crc = ~crc32_pclmul(~crc, data, chunk);
+        data += chunk;
+        length -= chunk;
+    }
+#elif defined(HAVE_ARM_ACCELERATION)
+    return crc32_arm(crc, data, length);
+#endif
+
+    while (length > 0) {
+        auto n = length > UINT32_MAX ? UINT32_MAX : static_cast<uInt>(length);
+        crc = static_cast<uint32_t>(::crc32(crc, data, n));
+        data += n;
+        length -= n;
+    }
+
+    return crc;
+}
+
+
+void HashesAccelerated::sha1_blocks(uint32_t *state, const uint8_t *data, size_t blocks) {
+#if defined(HAVE_X86_ACCELERATION)
+    sha1_shani(state, data, blocks);
+#else
+    (void)state;
+    (void)data;
+    (void)blocks;
+#endif
+}
+
+
+HashesAccelerated::Sha1::Sha1() : state{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0}, length(0), buffer{}, buffer_length(0) {
+}
+
+
+void HashesAccelerated::Sha1::update(const uint8_t *data, size_t data_length) {
+    length += data_length;
+
+    if (buffer_length > 0) {
+        auto n = std::min(data_length, sizeof(buffer) - buffer_length);
+        memcpy(buffer + buffer_length, data, n);
+        buffer_length += n;
+        data += n;
+        data_length -= n;
+        if (buffer_length < sizeof(buffer)) {
+            return;
+        }
+        sha1_blocks(state, buffer, 1);
+        buffer_length = 0;
+    }
+
+    auto blocks = data_length / sizeof(buffer);
+    if (blocks > 0) {
+        sha1_blocks(state, data, blocks);
+        data += blocks * sizeof(buffer);
+        data_length -= blocks * sizeof(buffer);
+    }
+
+    memcpy(buffer, data, data_length);
+    buffer_length = data_length;
+}
+
+
+void HashesAccelerated::Sha1::final(uint8_t *digest) {
+    uint64_t bits = length * 8;
+    uint8_t padding[sizeof(buffer) * 2] = {0x80};
+
+    auto padding_length = (buffer_length < 56 ? 56 : 120) - buffer_length;
+    for (size_t i = 0; i < 8; i++) {
+        padding[padding_length + i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+    }
+    update(padding, padding_length + 8);
+
+    for (size_t i = 0; i < 5; i++) {
+        digest[4 * i] = static_cast<uint8_t>(state[i] >> 24);
+        digest[4 * i + 1] = static_cast<uint8_t>(state[i] >> 16);
+        digest[4 * i + 2] = static_cast<uint8_t>(state[i] >> 8);
+        digest[4 * i + 3] = static_cast<uint8_t>(state[i]);
+    }
+}
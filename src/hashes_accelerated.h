@@ -0,0 +1,84 @@
+#ifndef HAD_HASHES_ACCELERATED_H
+#define HAD_HASHES_ACCELERATED_H
+
+/*
+hashes_accelerated.h -- hardware accelerated hash functions
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// CRC32 and SHA1 using CPU instructions (PCLMULQDQ, SHA-NI, ARMv8 CRC32), selected at runtime.
+// MD5 of several independent inputs computed at once in SIMD lanes (AVX2, SSE2, NEON).
+class HashesAccelerated {
+public:
+    class Md5Job {
+    public:
+        Md5Job(const uint8_t *data_, size_t length_, uint8_t *digest_) : data(data_), length(length_), digest(digest_) { }
+
+        const uint8_t *data;
+        size_t length;
+        uint8_t *digest;
+    };
+
+    class Sha1 {
+    public:
+        Sha1();
+
+        void update(const uint8_t *data, size_t length);
+        void final(uint8_t *digest);
+
+    private:
+        uint32_t state[5];
+        uint64_t length;
+        uint8_t buffer[64];
+        size_t buffer_length;
+    };
+
+    static bool enabled; // cleared to compare against portable implementations
+
+    static bool have_crc32();
+    static bool have_sha1();
+    static size_t md5_lanes(); // 0 if multi-buffer MD5 is not available
+    static std::string description();
+
+    // same semantics as zlib's crc32()
+    static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t length);
+    static void md5_multi(const std::vector<Md5Job> &jobs);
+
+private:
+    static void sha1_blocks(uint32_t *state, const uint8_t *data, size_t blocks);
+};
+
+#endif // HAD_HASHES_ACCELERATED_H
@@ -55,12 +55,18 @@ extern "C" {
 }
 
 #include "Hashes.h"
+#include "hashes_accelerated.h"
 
 class HashesContexts {
 public:
+    HashesContexts() : crc(0), accelerated_crc(false) { }
+
     uint32_t crc;
     MD5_CTX md5;
     SHA1_CTX sha1;
+
+    bool accelerated_crc;
+    std::unique_ptr<HashesAccelerated::Sha1> accelerated_sha1;
 };
 
 Hashes::Update::Update(Hashes *hashes_) : hashes(hashes_) {
@@ -68,12 +74,18 @@ Hashes::Update::Update(Hashes *hashes_) : hashes(hashes_) {
 
     if (hashes->has_type(TYPE_CRC)) {
         contexts->crc = static_cast<uint32_t>(crc32(0, nullptr, 0));
+        contexts->accelerated_crc = HashesAccelerated::have_crc32();
     }
     if (hashes->has_type(TYPE_MD5)) {
         MD5Init(&contexts->md5);
     }
     if (hashes->has_type(TYPE_SHA1)) {
-        SHA1Init(&contexts->sha1);
+        if (HashesAccelerated::have_sha1()) {
+            contexts->accelerated_sha1 = std::make_unique<HashesAccelerated::Sha1>();
+        }
+        else {
+            SHA1Init(&contexts->sha1);
+        }
     }
 }
 
@@ -81,20 +93,29 @@ Hashes::Update::~Update() {
     contexts = nullptr;
 }
 
-void Hashes::Update::update(const void *data, size_t length) {
+void Hashes::Update::update(const void *data_, size_t length) {
+    auto data = static_cast<const uint8_t *>(data_);
+
+    if (hashes->has_type(TYPE_CRC) && contexts->accelerated_crc) {
+        contexts->crc = HashesAccelerated::crc32(contexts->crc, data, length);
+    }
+    if (hashes->has_type(TYPE_SHA1) && contexts->accelerated_sha1) {
+        contexts->accelerated_sha1->update(data, length);
+    }
+
     size_t i = 0;
 
     while (i < length) {
 	unsigned int n = length - i > UINT_MAX ? UINT_MAX : static_cast<unsigned int>(length - i);
 
-        if (hashes->has_type(TYPE_CRC)) {
-            contexts->crc = static_cast<uint32_t>(crc32(contexts->crc, static_cast<const Bytef *>(data), n));
+        if (hashes->has_type(TYPE_CRC) && !contexts->accelerated_crc) {
+            contexts->crc = static_cast<uint32_t>(crc32(contexts->crc, static_cast<const Bytef *>(data + i), n));
         }
         if (hashes->has_type(TYPE_MD5)) {
-            MD5Update(&contexts->md5, static_cast<const unsigned char *>(data), n);
+            MD5Update(&contexts->md5, static_cast<const unsigned char *>(data + i), n);
         }
-        if (hashes->has_type(TYPE_SHA1)) {
-            SHA1Update(&contexts->sha1, static_cast<const uint8_t *>(data), n);
+        if (hashes->has_type(TYPE_SHA1) && !contexts->accelerated_sha1) {
+            SHA1Update(&contexts->sha1, static_cast<const uint8_t *>(data + i), n);
         }
 
         i += n;
@@ -110,6 +131,11 @@ void Hashes::Update::end() {
         MD5Final(hashes->md5.data(), &contexts->md5);
     }
     if (hashes->has_type(TYPE_SHA1)) {
-        SHA1Final(hashes->sha1.data(), &contexts->sha1);
+        if (contexts->accelerated_sha1) {
+            contexts->accelerated_sha1->final(hashes->sha1.data());
+        }
+        else {
+            SHA1Final(hashes->sha1.data(), &contexts->sha1);
+        }
     }
 }
@@ -71,7 +71,7 @@ std::vector<Commandline::Option> mkmamedb_options = {
 };
 
 std::unordered_set<std::string> mkmamedb_used_variables = {
-    "dats", "dat_directories", "roms_zipped", "use_description_as_name", "use_temp_directory"
+    "dats", "dat_directories", "jobs", "rom_db_snapshot", "roms_zipped", "use_description_as_name", "use_temp_directory", "verbose"
 };
 
 #define DEFAULT_FILE_PATTERNS "*.dat"
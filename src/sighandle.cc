@@ -35,9 +35,11 @@
 
 #include <csignal>
 
+#include "Exception.h"
 #include "globals.h"
 
 volatile int siginfo_caught;
+volatile int sigint_caught;
 
 void sighandle(int signo) {
     switch (signo) {
@@ -46,12 +48,25 @@ void sighandle(int signo) {
         siginfo_caught = 1;
         break;
 #endif
+    case SIGINT:
+    case SIGTERM:
+        // Stop at the next safe point; a second signal terminates immediately.
+        sigint_caught = 1;
+        signal(signo, SIG_DFL);
+        break;
     default:
         break;
     }
 }
 
 
+void check_interrupted() {
+    if (sigint_caught) {
+        throw Exception("interrupted");
+    }
+}
+
+
 void print_info(const std::string &message) {
     printf("ckmame: %s", message.c_str());
     if (!configuration.set.empty()) {
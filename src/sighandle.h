@@ -37,7 +37,9 @@
 #include <string>
 
 extern volatile int siginfo_caught;
+extern volatile int sigint_caught;
 
+void check_interrupted();
 void print_info(const std::string& message);
 void sighandle(int);
 
@@ -0,0 +1,302 @@
+/*
+swap_accelerated.cc -- byte and bit swapping using SIMD instructions
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "swap_accelerated.h"
+
+#include <cstdlib>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_ACCELERATION
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define HAVE_ARM_ACCELERATION
+#include <arm_neon.h>
+#endif
+
+bool SwapAccelerated::enabled = true;
+
+namespace {
+enum Kernel {
+    KERNEL_PORTABLE,
+    KERNEL_SSSE3,
+    KERNEL_AVX2,
+    KERNEL_NEON
+};
+
+Kernel detect_kernel() {
+    if (getenv("CKMAME_NO_ACCELERATED_SWAPS") != nullptr) {
+        return KERNEL_PORTABLE;
+    }
+#if defined(HAVE_X86_ACCELERATION)
+    unsigned int eax, ebx, ecx, edx;
+
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0 || (ecx & bit_SSSE3) == 0) {
+        return KERNEL_PORTABLE;
+    }
+
+    auto os_saves_avx = false;
+    if ((ecx & bit_OSXSAVE) != 0) {
+        // AVX state must be enabled by the operating system
+        unsigned int xcr0_low, xcr0_high;
+        __asm__("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+        os_saves_avx = (xcr0_low & 0x6) == 0x6;
+    }
+
+    if (os_saves_avx && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) != 0 && (ebx & bit_AVX2) != 0) {
+        return KERNEL_AVX2;
+    }
+    return KERNEL_SSSE3;
+#elif defined(HAVE_ARM_ACCELERATION)
+    // NEON is part of ARMv8
+    return KERNEL_NEON;
+#else
+    return KERNEL_PORTABLE;
+#endif
+}
+
+Kernel kernel() {
+    static const Kernel detected = detect_kernel();
+    return SwapAccelerated::enabled ? detected : KERNEL_PORTABLE;
+}
+
+const uint8_t bitswap_table[] = {
+    0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0, 0x08, 0x88, 0x48, 0xC8, 0x28, 0xA8, 0x68, 0xE8, 0x18, 0x98, 0x58, 0xD8, 0x38, 0xB8, 0x78, 0xF8, 0x04, 0x84, 0x44, 0xC4, 0x24, 0xA4, 0x64, 0xE4, 0x14, 0x94, 0x54, 0xD4, 0x34, 0xB4, 0x74, 0xF4, 0x0C, 0x8C, 0x4C, 0xCC, 0x2C, 0xAC, 0x6C, 0xEC, 0x1C, 0x9C, 0x5C, 0xDC, 0x3C, 0xBC, 0x7C, 0xFC, 0x02, 0x82, 0x42, 0xC2, 0x22, 0xA2, 0x62, 0xE2, 0x12, 0x92, 0x52, 0xD2, 0x32, 0xB2, 0x72, 0xF2, 0x0A, 0x8A, 0x4A, 0xCA, 0x2A, 0xAA, 0x6A, 0xEA, 0x1A, 0x9A, 0x5A, 0xDA, 0x3A, 0xBA, 0x7A, 0xFA, 0x06, 0x86, 0x46, 0xC6, 0x26, 0xA6, 0x66, 0xE6, 0x16, 0x96, 0x56, 0xD6, 0x36, 0xB6, 0x76, 0xF6, 0x0E, 0x8E, 0x4E, 0xCE, 0x2E, 0xAE, 0x6E, 0xEE, 0x1E, 0x9E, 0x5E, 0xDE, 0x3E, 0xBE, 0x7E, 0xFE, 0x01, 0x81, 0x41, 0xC1, 0x21, 0xA1, 0x61, 0xE1, 0x11, 0x91, 0x51, 0xD1, 0x31, 0xB1, 0x71, 0xF1, 0x09, 0x89, 0x49, 0xC9, 0x29, 0xA9, 0x69, 0xE9, 0x19, 0x99, 0x59, 0xD9, 0x39, 0xB9, 0x79, 0xF9, 0x05, 0x85, 0x45, 0xC5, 0x25, 0xA5, 0x65, 0xE5, 0x15, 0x95, 0x55, 0xD5, 0x35, 0xB5, 0x75, 0xF5, 0x0D, 0x8D, 0x4D, 0xCD, 0x2D, 0xAD, 0x6D, 0xED, 0x1D, 0x9D, 0x5D, 0xDD, 0x3D, 0xBD, 0x7D, 0xFD, 0x03, 0x83, 0x43, 0xC3, 0x23, 0xA3, 0x63, 0xE3, 0x13, 0x93, 0x53, 0xD3, 0x33, 0xB3, 0x73, 0xF3, 0x0B, 0x8B, 0x4B, 0xCB, 0x2B, 0xAB, 0x6B, 0xEB, 0x1B, 0x9B, 0x5B, 0xDB, 0x3B, 0xBB, 0x7B, 0xFB, 0x07, 0x87, 0x47, 0xC7, 0x27, 0xA7, 0x67, 0xE7, 0x17, 0x97, 0x57, 0xD7, 0x37, 0xB7, 0x77, 0xF7, 0x0F, 0x8F, 0x4F, 0xCF, 0x2F, 0xAF, 0x6F, 0xEF, 0x1F, 0x9F, 0x5F, 0xDF, 0x3F, 0xBF, 0x7F, 0xFF
+};
+
+void bitswap_portable(uint8_t *out, const uint8_t *in, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        out[i] = bitswap_table[in[i]];
+    }
+}
+
+void byteswap_portable(uint8_t *out, const uint8_t *in, size_t length) {
+    for (size_t i = 0; i < length; i += 2) {
+        auto b0 = in[i];
+        out[i] = in[i + 1];
+        out[i + 1] = b0;
+    }
+}
+
+void wordswap_portable(uint8_t *out, const uint8_t *in, size_t length) {
+    for (size_t i = 0; i < length; i += 4) {
+        auto b0 = in[i];
+        auto b1 = in[i + 1];
+        out[i] = in[i + 3];
+        out[i + 1] = in[i + 2];
+        out[i + 2] = b1;
+        out[i + 3] = b0;
+    }
+}
+
+#if defined(HAVE_X86_ACCELERATION)
+// Shuffle patterns for pshufb, repeated for both lanes of AVX2.
+alignas(32) const int8_t reversed_nibbles[] = {0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe, 0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf, 0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe, 0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf};
+alignas(32) const int8_t byteswap_pattern[] = {1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14, 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14};
+alignas(32) const int8_t wordswap_pattern[] = {3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12};
+
+// Each nibble is reversed by table lookup, then the two nibbles are exchanged.
+// These return the number of bytes processed, the caller handles the rest.
+__attribute__((target("ssse3"))) size_t bitswap_ssse3(uint8_t *out, const uint8_t *in, size_t length) {
+    auto table = _mm_load_si128(reinterpret_cast<const __m128i *>(reversed_nibbles));
+    auto low_nibbles = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+
+    for (; i + 16 <= length; i += 16) {
+        auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        auto low = _mm_shuffle_epi8(table, _mm_and_si128(x, low_nibbles));
+        auto high = _mm_shuffle_epi8(table, _mm_and_si128(_mm_srli_epi16(x, 4), low_nibbles));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_or_si128(_mm_slli_epi16(low, 4), high));
+    }
+
+    return i;
+}
+
+__attribute__((target("ssse3"))) size_t shuffle_ssse3(uint8_t *out, const uint8_t *in, size_t length, const int8_t *pattern) {
+    auto shuffle = _mm_load_si128(reinterpret_cast<const __m128i *>(pattern));
+    size_t i = 0;
+
+    for (; i + 16 <= length; i += 16) {
+        auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_shuffle_epi8(x, shuffle));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2"))) size_t bitswap_avx2(uint8_t *out, const uint8_t *in, size_t length) {
+    auto table = _mm256_load_si256(reinterpret_cast<const __m256i *>(reversed_nibbles));
+    auto low_nibbles = _mm256_set1_epi8(0x0f);
+    size_t i = 0;
+
+    for (; i + 32 <= length; i += 32) {
+        auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+        auto low = _mm256_shuffle_epi8(table, _mm256_and_si256(x, low_nibbles));
+        auto high = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(x, 4), low_nibbles));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_or_si256(_mm256_slli_epi16(low, 4), high));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2"))) size_t shuffle_avx2(uint8_t *out, const uint8_t *in, size_t length, const int8_t *pattern) {
+    auto shuffle = _mm256_load_si256(reinterpret_cast<const __m256i *>(pattern));
+    size_t i = 0;
+
+    for (; i + 32 <= length; i += 32) {
+        auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_shuffle_epi8(x, shuffle));
+    }
+
+    return i;
+}
+#endif
+
+#if defined(HAVE_ARM_ACCELERATION)
+size_t bitswap_neon(uint8_t *out, const uint8_t *in, size_t length) {
+    size_t i = 0;
+
+    for (; i + 16 <= length; i += 16) {
+        vst1q_u8(out + i, vrbitq_u8(vld1q_u8(in + i)));
+    }
+
+    return i;
+}
+
+size_t byteswap_neon(uint8_t *out, const uint8_t *in, size_t length) {
+    size_t i = 0;
+
+    for (; i + 16 <= length; i += 16) {
+        vst1q_u8(out + i, vrev16q_u8(vld1q_u8(in + i)));
+    }
+
+    return i;
+}
+
+size_t wordswap_neon(uint8_t *out, const uint8_t *in, size_t length) {
+    size_t i = 0;
+
+    for (; i + 16 <= length; i += 16) {
+        vst1q_u8(out + i, vrev32q_u8(vld1q_u8(in + i)));
+    }
+
+    return i;
+}
+#endif
+} // namespace
+
+
+std::string SwapAccelerated::description() {
+    switch (kernel()) {
+    case KERNEL_SSSE3:
+        return "ssse3";
+    case KERNEL_AVX2:
+        return "avx2";
+    case KERNEL_NEON:
+        return "neon";
+    default:
+        return "portable";
+    }
+}
+
+
+void SwapAccelerated::bitswap(uint8_t *out, const uint8_t *in, size_t length) {
+    size_t done = 0;
+
+    switch (kernel()) {
+#if defined(HAVE_X86_ACCELERATION)
+    case KERNEL_AVX2:
+        done = bitswap_avx2(out, in, length);
+        break;
+    case KERNEL_SSSE3:
+        done = bitswap_ssse3(out, in, length);
+        break;
+#elif defined(HAVE_ARM_ACCELERATION)
+    case KERNEL_NEON:
+        done = bitswap_neon(out, in, length);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    bitswap_portable(out + done, in + done, length - done);
+}
+
+
+void SwapAccelerated::byteswap(uint8_t *out, const uint8_t *in, size_t length) {
+    size_t done = 0;
+
+    switch (kernel()) {
+#if defined(HAVE_X86_ACCELERATION)
+    case KERNEL_AVX2:
+        done = shuffle_avx2(out, in, length, byteswap_pattern);
+        break;
+    case KERNEL_SSSE3:
+        done = shuffle_ssse3(out, in, length, byteswap_pattern);
+        break;
+#elif defined(HAVE_ARM_ACCELERATION)
+    case KERNEL_NEON:
+        done = byteswap_neon(out, in, length);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    byteswap_portable(out + done, in + done, length - done);
+}
+
+
+void SwapAccelerated::wordswap(uint8_t *out, const uint8_t *in, size_t length) {
+    size_t done = 0;
+
+    switch (kernel()) {
+#if defined(HAVE_X86_ACCELERATION)
+    case KERNEL_AVX2:
+        done = shuffle_avx2(out, in, length, wordswap_pattern);
+        break;
+    case KERNEL_SSSE3:
+        done = shuffle_ssse3(out, in, length, wordswap_pattern);
+        break;
+#elif defined(HAVE_ARM_ACCELERATION)
+    case KERNEL_NEON:
+        done = wordswap_neon(out, in, length);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    wordswap_portable(out + done, in + done, length - done);
+}
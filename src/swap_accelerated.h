@@ -0,0 +1,54 @@
+#ifndef HAD_SWAP_ACCELERATED_H
+#define HAD_SWAP_ACCELERATED_H
+
+/*
+swap_accelerated.h -- byte and bit swapping using SIMD instructions
+Copyright (C) 2022 Dieter Baron and Thomas Klausner
+
+This file is part of ckmame, a program to check rom sets for MAME.
+The authors can be contacted at <ckmame@nih.at>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in
+   the documentation and/or other materials provided with the
+   distribution.
+3. The name of the author may not be used to endorse or promote
+   products derived from this software without specific prior
+   written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHORS ``AS IS'' AND ANY EXPRESS
+OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Bit reversal and byte order swaps for detector operations, using SSSE3, AVX2, or NEON, selected at runtime.
+// out and in may be the same, but must not overlap otherwise.
+class SwapAccelerated {
+public:
+    static bool enabled; // cleared to compare against portable implementations
+
+    static std::string description();
+
+    static void bitswap(uint8_t *out, const uint8_t *in, size_t length);
+    static void byteswap(uint8_t *out, const uint8_t *in, size_t length); // length must be a multiple of 2
+    static void wordswap(uint8_t *out, const uint8_t *in, size_t length); // length must be a multiple of 4
+};
+
+#endif // HAD_SWAP_ACCELERATED_H